@@ -0,0 +1,24 @@
+QT+=opengl
+LIBS+=-lGLU
+TEMPLATE = app
+TARGET = ../bin/ball-impulse
+OBJECTS_DIR=../build/app/obj
+MOC_DIR=../build/app/moc
+
+include(../common.pri)
+include(../core/core.pri)
+
+# You can make your code fail to compile if you use deprecated APIs.
+# In order to do so, uncomment the following line.
+# Please consult the documentation of the deprecated API in order to know
+# how to port your code away from it.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+# Input
+HEADERS += ../src/BallImpulseWidget.h \
+           ../src/Scene.h
+
+SOURCES += ../src/BallImpulseWidget.cpp \
+           ../src/main.cpp \
+           ../src/Scene.cpp
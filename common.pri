@@ -0,0 +1,8 @@
+# Settings shared by every project in the tree
+CONFIG += c++17 thread
+INCLUDEPATH += $$PWD/src
+
+# qmake CONFIG+=native_simd builds for the host CPU, enabling the AVX/AVX-512 paths in Simd.h
+native_simd {
+    QMAKE_CXXFLAGS += -march=native
+}
@@ -0,0 +1,7 @@
+# Link a project against the core library built by core.pro
+CORE_LIB_DIR = $$shadowed($$PWD)/../build/lib
+
+LIBS += -L$$CORE_LIB_DIR -lball-impulse-core
+
+win32-msvc*: PRE_TARGETDEPS += $$CORE_LIB_DIR/ball-impulse-core.lib
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/libball-impulse-core.a
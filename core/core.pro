@@ -0,0 +1,60 @@
+# Qt-free static library with the math, surfaces, terrain queries and ball physics
+TEMPLATE = lib
+CONFIG += staticlib
+CONFIG -= qt
+TARGET = ball-impulse-core
+DESTDIR = ../build/lib
+OBJECTS_DIR = ../build/core/obj
+
+include(../common.pri)
+
+HEADERS += ../src/BallSet.h \
+           ../src/BinaryIO.h \
+           ../src/Cartesian3.h \
+           ../src/ContactSolver.h \
+           ../src/Geometry.h \
+           ../src/HeightField.h \
+           ../src/HeightGrid.h \
+           ../src/HeightPyramid.h \
+           ../src/Integrators.h \
+           ../src/Homogeneous4.h \
+           ../src/IndexedFaceSurface.h \
+           ../src/LaunchSweep.h \
+           ../src/MappedFile.h \
+           ../src/Matrix3.h \
+           ../src/Matrix4.h \
+           ../src/PagedTerrain.h \
+           ../src/PhysicsConstants.h \
+           ../src/Quaternion.h \
+           ../src/RigidBody.h \
+           ../src/Simd.h \
+           ../src/Simulation.h \
+           ../src/SupportMap.h \
+           ../src/Terrain.h \
+           ../src/TextParsing.h \
+           ../src/TriangleBvh.h \
+           ../src/WorkStealingExecutor.h
+
+SOURCES += ../src/BallSet.cpp \
+           ../src/BinaryIO.cpp \
+           ../src/Cartesian3.cpp \
+           ../src/ContactSolver.cpp \
+           ../src/Geometry.cpp \
+           ../src/HeightField.cpp \
+           ../src/HeightGrid.cpp \
+           ../src/HeightPyramid.cpp \
+           ../src/Homogeneous4.cpp \
+           ../src/IndexedFaceSurface.cpp \
+           ../src/LaunchSweep.cpp \
+           ../src/MappedFile.cpp \
+           ../src/Matrix3.cpp \
+           ../src/Matrix4.cpp \
+           ../src/PagedTerrain.cpp \
+           ../src/Quaternion.cpp \
+           ../src/RigidBody.cpp \
+           ../src/Simulation.cpp \
+           ../src/SupportMap.cpp \
+           ../src/Terrain.cpp \
+           ../src/TextParsing.cpp \
+           ../src/TriangleBvh.cpp \
+           ../src/WorkStealingExecutor.cpp
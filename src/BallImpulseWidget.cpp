@@ -15,8 +15,10 @@ BallImpulseWidget::BallImpulseWidget(QWidget* parent, Scene* TheScene)
     : _GEOMETRIC_WIDGET_PARENT_CLASS(parent),
       scene(TheScene) {
     animationTimer = new QTimer(this);
+    animationTimer->setTimerType(Qt::PreciseTimer);
     connect(animationTimer, SIGNAL(timeout()), this, SLOT(nextFrame()));
-    animationTimer->start(16.6667f);
+    animationTimer->start(16);
+    frameClock.start();
 }
 
 void BallImpulseWidget::initializeGL() {
@@ -85,6 +87,18 @@ void BallImpulseWidget::keyPressEvent(QKeyEvent* event) {
         case Qt::Key_M:
             scene->switchModel();
             break;
+        case Qt::Key_C:
+            scene->switchCollisionMode();
+            break;
+        case Qt::Key_T:
+            scene->switchEventDriven();
+            break;
+        case Qt::Key_BracketRight:
+            scene->increaseSubSteps();
+            break;
+        case Qt::Key_BracketLeft:
+            scene->decreaseSubSteps();
+            break;
         case Qt::Key_Greater:
             scene->rotateLaunchLeft();
             break;
@@ -97,7 +111,9 @@ void BallImpulseWidget::keyPressEvent(QKeyEvent* event) {
 }
 
 void BallImpulseWidget::nextFrame() {
-    scene->update();
+    const float elapsedSeconds = static_cast<float>(frameClock.nsecsElapsed()) * 1.0e-9f;
+    frameClock.restart();
+    scene->update(elapsedSeconds);
 
     update();
 }
@@ -3,6 +3,7 @@
 
 #include <QtGlobal>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QMouseEvent>
 
 // this is necessary to allow compilation in both Qt 5 and Qt 6
@@ -26,6 +27,9 @@ public:
 
     QTimer* animationTimer;
 
+    // wall-clock time since the previous frame, however late the timer fired
+    QElapsedTimer frameClock;
+
     BallImpulseWidget(QWidget* parent, Scene* TheScene);
 
 protected:
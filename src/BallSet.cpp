@@ -0,0 +1,380 @@
+#include "BallSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+#include "PhysicsConstants.h"
+#include "Simd.h"
+
+static_assert(BallSet::maxLanes % SimdFloat::width == 0, "padding must cover whole SIMD registers");
+
+// padding balls sit far below any terrain so they never collide
+constexpr float paddingHeight = -std::numeric_limits<float>::max();
+
+// cell (x, y, z) of the ball contact grid packed in 21 bits per axis, which wraps only past two million cells
+static uint64_t cellOf(const long x, const long y, const long z) {
+    constexpr uint64_t axisMask = (uint64_t(1) << 21) - 1;
+    return (static_cast<uint64_t>(x) & axisMask) << 42 | (static_cast<uint64_t>(y) & axisMask) << 21 |
+           (static_cast<uint64_t>(z) & axisMask);
+}
+
+// bucket of a cell among 2^bucketBits, by Fibonacci hashing: the top bits of the key times 2^64 / phi
+static size_t bucketOf(const uint64_t cell, const int bucketBits) {
+    return static_cast<size_t>((cell * 0x9E3779B97F4A7C15ULL) >> (64 - bucketBits));
+}
+
+BallSet::BallSet()
+    : collideBalls(false),
+      count(0) {
+}
+
+size_t BallSet::size() const {
+    return count;
+}
+
+void BallSet::reserve(const size_t reservedCount) {
+    const size_t paddedCount = (reservedCount + maxLanes - 1) / maxLanes * maxLanes;
+    for (auto* array : {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &radius,
+                        &slowTime, &slowX, &slowY, &slowZ, &terrainHeight, &terrainNormalX, &terrainNormalY, &terrainNormalZ}) {
+        array->reserve(paddedCount);
+    }
+}
+
+void BallSet::clear() {
+    count = 0;
+    resizeArrays(0);
+}
+
+size_t BallSet::addBall(const Cartesian3& position, const Cartesian3& velocity, const float ballRadius) {
+    const size_t ball = count++;
+    if (ball == positionX.size()) {
+        resizeArrays(ball + maxLanes);
+    }
+
+    positionX[ball] = position.x;
+    positionY[ball] = position.y;
+    positionZ[ball] = position.z;
+    velocityX[ball] = velocity.x;
+    velocityY[ball] = velocity.y;
+    velocityZ[ball] = velocity.z;
+    radius[ball] = ballRadius;
+    wake(ball);
+
+    return ball;
+}
+
+Cartesian3 BallSet::position(const size_t ball) const {
+    return Cartesian3(positionX[ball], positionY[ball], positionZ[ball]);
+}
+
+Cartesian3 BallSet::velocity(const size_t ball) const {
+    return Cartesian3(velocityX[ball], velocityY[ball], velocityZ[ball]);
+}
+
+bool BallSet::isSleeping(const size_t ball) const {
+    return slowTime[ball] > sleepDelay;
+}
+
+void BallSet::wake(const size_t ball) {
+    slowTime[ball] = 0.0f;
+    slowX[ball] = positionX[ball];
+    slowY[ball] = positionY[ball];
+    slowZ[ball] = positionZ[ball];
+}
+
+template <typename Scheme>
+void BallSet::update(const HeightField& terrain, const float frameTime) {
+    const size_t paddedCount = positionX.size();
+
+    // Broad phase, SimdFloat::width balls at a time: the height pyramid rules out whole blocks
+    // whose swept spheres all stay clear of the terrain this frame, so airborne balls skip the lookup.
+    // A zero normal then marks "no collision", which makes the impulse below vanish without any branching.
+    const SimdFloat dt(frameTime);
+    blockIsAwake.resize(paddedCount / SimdFloat::width);
+    blockMayCollide.resize(paddedCount / SimdFloat::width);
+    for (size_t first = 0; first < paddedCount; first += SimdFloat::width) {
+        const size_t last = std::min(first + SimdFloat::width, count);
+
+        // blocks of sleeping balls are left out of every pass below
+        bool isAwake = false;
+        for (size_t ball = first; ball < last; ball++) {
+            isAwake |= !isSleeping(ball);
+        }
+        blockIsAwake[first / SimdFloat::width] = isAwake;
+        if (!isAwake) {
+            blockMayCollide[first / SimdFloat::width] = false;
+            continue;
+        }
+
+        // x-y box and lowest point of the block's swept spheres, padding left out
+        float minX, minY, maxX, maxY, lowest;
+        if (last == first + SimdFloat::width) {
+            const SimdFloat startX = SimdFloat::load(&positionX[first]);
+            const SimdFloat startY = SimdFloat::load(&positionY[first]);
+            const SimdFloat startZ = SimdFloat::load(&positionZ[first]);
+            const SimdFloat endX = startX + SimdFloat::load(&velocityX[first]) * dt;
+            const SimdFloat endY = startY + SimdFloat::load(&velocityY[first]) * dt;
+            const SimdFloat endZ = startZ + SimdFloat::load(&velocityZ[first]) * dt;
+            const SimdFloat ballRadius = SimdFloat::load(&radius[first]);
+            minX = (SimdFloat::min(startX, endX) - ballRadius).minimum();
+            minY = (SimdFloat::min(startY, endY) - ballRadius).minimum();
+            maxX = (SimdFloat::max(startX, endX) + ballRadius).maximum();
+            maxY = (SimdFloat::max(startY, endY) + ballRadius).maximum();
+            lowest = (SimdFloat::min(startZ, endZ) - ballRadius).minimum();
+        } else {
+            minX = minY = lowest = std::numeric_limits<float>::max();
+            maxX = maxY = -std::numeric_limits<float>::max();
+            for (size_t ball = first; ball < last; ball++) {
+                const float endX = positionX[ball] + velocityX[ball] * frameTime;
+                const float endY = positionY[ball] + velocityY[ball] * frameTime;
+                const float endZ = positionZ[ball] + velocityZ[ball] * frameTime;
+                minX = std::min(minX, std::min(positionX[ball], endX) - radius[ball]);
+                minY = std::min(minY, std::min(positionY[ball], endY) - radius[ball]);
+                maxX = std::max(maxX, std::max(positionX[ball], endX) + radius[ball]);
+                maxY = std::max(maxY, std::max(positionY[ball], endY) + radius[ball]);
+                lowest = std::min(lowest, std::min(positionZ[ball], endZ) - radius[ball]);
+            }
+        }
+
+        blockMayCollide[first / SimdFloat::width] = first < last && terrain.mayReach(minX, minY, maxX, maxY, lowest);
+    }
+
+    // one batched lookup per run of blocks that may collide
+    for (size_t first = 0; first < paddedCount;) {
+        if (!blockMayCollide[first / SimdFloat::width]) {
+            first += SimdFloat::width;
+            continue;
+        }
+        size_t last = first + SimdFloat::width;
+        while (last < paddedCount && blockMayCollide[last / SimdFloat::width]) {
+            last += SimdFloat::width;
+        }
+        terrain.getHeightsAndNormals(&positionX[first], &positionY[first], last - first, &terrainHeight[first],
+                                     &terrainNormalX[first], &terrainNormalY[first], &terrainNormalZ[first]);
+        first = last;
+    }
+
+    for (size_t first = 0; first < paddedCount; first += SimdFloat::width) {
+        if (!blockMayCollide[first / SimdFloat::width]) {
+            std::fill_n(&terrainHeight[first], SimdFloat::width, paddingHeight);
+            for (auto* normal : {&terrainNormalX, &terrainNormalY, &terrainNormalZ}) {
+                std::fill_n(&(*normal)[first], SimdFloat::width, 0.0f);
+            }
+            continue;
+        }
+        for (size_t ball = first; ball < first + SimdFloat::width; ball++) {
+            if (ball >= count || !terrain.contains(positionX[ball], positionY[ball])) {
+                terrainHeight[ball] = paddingHeight;
+                terrainNormalX[ball] = terrainNormalY[ball] = terrainNormalZ[ball] = 0.0f;
+            } else if (positionZ[ball] - terrainHeight[ball] >= radius[ball]) {
+                terrainNormalX[ball] = terrainNormalY[ball] = terrainNormalZ[ball] = 0.0f;
+            }
+        }
+    }
+
+    // Integration and bounce response, SimdFloat::width balls at a time
+    const SimdFloat gravityX(gravity.x);
+    const SimdFloat gravityY(gravity.y);
+    const SimdFloat gravityZ(gravity.z);
+    const SimdFloat bounceFactor(-(1.0f + elasticity));
+    const SimdFloat zero(0.0f);
+    const SimdFloat sleepDistanceSquared(sleepSpeed * sleepDelay * sleepSpeed * sleepDelay);
+    const SimdFloat sleepTime(sleepDelay);
+
+    for (size_t first = 0; first < paddedCount; first += SimdFloat::width) {
+        if (!blockIsAwake[first / SimdFloat::width]) {
+            continue;
+        }
+        SimdFloat px = SimdFloat::load(&positionX[first]);
+        SimdFloat py = SimdFloat::load(&positionY[first]);
+        const SimdFloat startZ = SimdFloat::load(&positionZ[first]);
+        SimdFloat pz = startZ;
+
+        // Gravity is a permanent force
+        SimdFloat vx = Scheme::kick(SimdFloat::load(&velocityX[first]), gravityX, dt);
+        SimdFloat vy = Scheme::kick(SimdFloat::load(&velocityY[first]), gravityY, dt);
+        SimdFloat vz = Scheme::kick(SimdFloat::load(&velocityZ[first]), gravityZ, dt);
+
+        // bounce impulse along the terrain normal, zero for balls that are not colliding
+        const SimdFloat nx = SimdFloat::load(&terrainNormalX[first]);
+        const SimdFloat ny = SimdFloat::load(&terrainNormalY[first]);
+        const SimdFloat nz = SimdFloat::load(&terrainNormalZ[first]);
+        const SimdFloat impulse = bounceFactor * (vx * nx + vy * ny + vz * nz);
+        vx = vx + impulse * nx;
+        vy = vy + impulse * ny;
+        vz = vz + impulse * nz;
+
+        // Snap colliding spheres on top of the terrain to avoid penetration
+        const SimdFloat height = SimdFloat::load(&terrainHeight[first]);
+        const SimdFloat ballRadius = SimdFloat::load(&radius[first]);
+        const SimdMask isColliding = (pz - height) < ballRadius;
+        pz = SimdFloat::select(isColliding, height + ballRadius, pz);
+
+        // sleeping balls in an awake block keep their place
+        const SimdFloat slow = SimdFloat::load(&slowTime[first]);
+        const SimdMask isAsleep = sleepTime < slow;
+        vx = SimdFloat::select(isAsleep, zero, vx);
+        vy = SimdFloat::select(isAsleep, zero, vy);
+        vz = SimdFloat::select(isAsleep, zero, vz);
+
+        // After calculating velocity, update position with it
+        px = SimdFloat::select(isAsleep, px, Scheme::drift(px, vx, gravityX, dt));
+        py = SimdFloat::select(isAsleep, py, Scheme::drift(py, vy, gravityY, dt));
+        pz = SimdFloat::select(isAsleep, startZ, Scheme::drift(pz, vz, gravityZ, dt));
+        px.store(&positionX[first]);
+        py.store(&positionY[first]);
+        pz.store(&positionZ[first]);
+
+        // the others count how long they have stayed near one point, starting over wherever they leave it
+        const SimdFloat anchorX = SimdFloat::load(&slowX[first]);
+        const SimdFloat anchorY = SimdFloat::load(&slowY[first]);
+        const SimdFloat anchorZ = SimdFloat::load(&slowZ[first]);
+        const SimdFloat dx = px - anchorX;
+        const SimdFloat dy = py - anchorY;
+        const SimdFloat dz = pz - anchorZ;
+        const SimdMask isSlow = (dx * dx + dy * dy + dz * dz) < sleepDistanceSquared;
+        const SimdFloat slowNow = SimdFloat::select(isSlow, slow + dt, zero);
+        slowNow.store(&slowTime[first]);
+        SimdFloat::select(isSlow, anchorX, px).store(&slowX[first]);
+        SimdFloat::select(isSlow, anchorY, py).store(&slowY[first]);
+        SimdFloat::select(isSlow, anchorZ, pz).store(&slowZ[first]);
+
+        // a ball falling asleep stops where it is, as in Simulation, since its block may not be stepped again
+        const SimdMask fallsAsleep = sleepTime < slowNow;
+        SimdFloat::select(fallsAsleep, zero, vx).store(&velocityX[first]);
+        SimdFloat::select(fallsAsleep, zero, vy).store(&velocityY[first]);
+        SimdFloat::select(fallsAsleep, zero, vz).store(&velocityZ[first]);
+    }
+
+    if (collideBalls) {
+        collideWithBalls();
+    }
+}
+
+template void BallSet::update<SemiImplicitEuler>(const HeightField& terrain, float frameTime);
+template void BallSet::update<VelocityVerlet>(const HeightField& terrain, float frameTime);
+template void BallSet::update<RungeKutta4>(const HeightField& terrain, float frameTime);
+
+void BallSet::collideWithBalls() {
+    float largestRadius = 0.0f;
+    for (size_t ball = 0; ball < count; ball++) {
+        largestRadius = std::max(largestRadius, radius[ball]);
+    }
+    if (count < 2 || largestRadius <= 0.0f) {
+        return;
+    }
+
+    // counting sort of the balls by bucket: linear in the ball count, unlike a sort by cell
+    const float cellSize = 2.0f * largestRadius;
+    int bucketBits = 1;
+    while ((size_t(1) << bucketBits) < 2 * count) {
+        bucketBits++;
+    }
+    const size_t bucketCount = size_t(1) << bucketBits;
+    ballCell.resize(count);
+    bucketStart.assign(bucketCount + 1, 0);
+    for (size_t ball = 0; ball < count; ball++) {
+        ballCell[ball] = cellOf(static_cast<long>(std::floor(positionX[ball] / cellSize)),
+                                static_cast<long>(std::floor(positionY[ball] / cellSize)),
+                                static_cast<long>(std::floor(positionZ[ball] / cellSize)));
+        bucketStart[bucketOf(ballCell[ball], bucketBits) + 1]++;
+    }
+    std::partial_sum(bucketStart.begin(), bucketStart.end(), bucketStart.begin());
+    cellBalls.resize(count);
+    cellKeys.resize(count);
+    for (size_t ball = 0; ball < count; ball++) {
+        const unsigned entry = bucketStart[bucketOf(ballCell[ball], bucketBits)]++;
+        cellBalls[entry] = static_cast<unsigned>(ball);
+        cellKeys[entry] = ballCell[ball];
+    }
+    // filling moved every start up to the next bucket's, shift them back
+    std::copy_backward(bucketStart.begin(), bucketStart.end() - 1, bucketStart.end());
+    bucketStart[0] = 0;
+
+    // sleeping balls do not go looking for contacts, but are found by the moving balls that hit them.
+    // Who sleeps is fixed as the pass starts: a sleeper woken by a higher index ball must still be
+    // found by the moving balls it meets later in the pass
+    wasSleeping.resize(count);
+    for (size_t ball = 0; ball < count; ball++) {
+        wasSleeping[ball] = isSleeping(ball);
+    }
+    for (size_t ball = 0; ball < count; ball++) {
+        if (wasSleeping[ball]) {
+            continue;
+        }
+        const long cellX = static_cast<long>(std::floor(positionX[ball] / cellSize));
+        const long cellY = static_cast<long>(std::floor(positionY[ball] / cellSize));
+        const long cellZ = static_cast<long>(std::floor(positionZ[ball] / cellSize));
+
+        // the 27 cells around the ball's own, skipping the balls of other cells sharing their buckets
+        // before their positions are ever read
+        for (long dx = -1; dx <= 1; dx++) {
+            for (long dy = -1; dy <= 1; dy++) {
+                for (long dz = -1; dz <= 1; dz++) {
+                    const uint64_t cell = cellOf(cellX + dx, cellY + dy, cellZ + dz);
+                    const size_t bucket = bucketOf(cell, bucketBits);
+                    for (unsigned entry = bucketStart[bucket]; entry < bucketStart[bucket + 1]; entry++) {
+                        // every pair once: from its lower index, or from the moving ball if the other sleeps
+                        const unsigned other = cellBalls[entry];
+                        if (cellKeys[entry] == cell && (other > ball || wasSleeping[other])) {
+                            collidePair(ball, other);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void BallSet::collidePair(const size_t ball, const size_t other) {
+    const Cartesian3 offset = position(other) - position(ball);
+    const float reach = radius[ball] + radius[other];
+    const float distanceSquared = offset.dot(offset);
+    if (distanceSquared >= reach * reach || distanceSquared == 0.0f) {
+        return;
+    }
+
+    // equal masses share the bounce impulse along the line between the centres
+    const float distance = std::sqrt(distanceSquared);
+    const Cartesian3 normal = offset / distance;
+    const float normalSpeed = (velocity(other) - velocity(ball)).dot(normal);
+    if (normalSpeed >= 0.0f) {
+        return;
+    }
+    const Cartesian3 bounceImpulse = -0.5f * (1.0f + elasticity) * normalSpeed * normal;
+    const Cartesian3 ballVelocity = velocity(ball) - bounceImpulse;
+    const Cartesian3 otherVelocity = velocity(other) + bounceImpulse;
+    velocityX[ball] = ballVelocity.x;
+    velocityY[ball] = ballVelocity.y;
+    velocityZ[ball] = ballVelocity.z;
+    velocityX[other] = otherVelocity.x;
+    velocityY[other] = otherVelocity.y;
+    velocityZ[other] = otherVelocity.z;
+
+    // Snap the two balls apart to avoid penetration
+    const Cartesian3 separation = 0.5f * (reach - distance) * normal;
+    positionX[ball] -= separation.x;
+    positionY[ball] -= separation.y;
+    positionZ[ball] -= separation.z;
+    positionX[other] += separation.x;
+    positionY[other] += separation.y;
+    positionZ[other] += separation.z;
+
+    // a sleeping ball hit by a moving one has to move again
+    if (isSleeping(other)) {
+        wake(other);
+    }
+}
+
+void BallSet::resizeArrays(const size_t paddedCount) {
+    for (auto* array : {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                        &slowX, &slowY, &slowZ, &terrainNormalX, &terrainNormalY, &terrainNormalZ}) {
+        array->resize(paddedCount, 0.0f);
+    }
+    radius.resize(paddedCount, 0.0f);
+    slowTime.resize(paddedCount, std::numeric_limits<float>::max());
+    terrainHeight.resize(paddedCount, paddingHeight);
+}
@@ -0,0 +1,92 @@
+#ifndef BALL_SET_H
+#define BALL_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Cartesian3.h"
+#include "HeightField.h"
+#include "Integrators.h"
+
+// Many spherical balls stored as structure-of-arrays, stepped together against one terrain.
+// Every array is padded to a multiple of maxLanes with inert balls, so the SIMD loop needs no tail.
+class BallSet {
+public:
+    // widest SIMD register supported, in floats
+    static constexpr size_t maxLanes = 16;
+
+    // per ball state, one entry per ball (plus padding)
+    std::vector<float> positionX, positionY, positionZ;
+    // it is assumed mass = 1 => velocity is effectively linear momentum
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> radius;
+
+    // true -> balls bounce off each other as well as off the terrain
+    bool collideBalls;
+
+    BallSet();
+
+    // number of real (not padding) balls
+    size_t size() const;
+
+    void reserve(size_t count);
+
+    void clear();
+
+    // append a ball, returning its index
+    size_t addBall(const Cartesian3& position, const Cartesian3& velocity, float ballRadius);
+
+    Cartesian3 position(size_t ball) const;
+
+    Cartesian3 velocity(size_t ball) const;
+
+    // true once the ball's average speed has stayed under sleepSpeed for sleepDelay; sleeping balls are not moved
+    bool isSleeping(size_t ball) const;
+
+    // step a sleeping ball again, e.g. after changing its position or velocity
+    void wake(size_t ball);
+
+    // advance every ball that is awake by frameTime: gravity, terrain collision and bounce impulse,
+    // moving the balls with the integration scheme Scheme (see Integrators.h), then ball contacts
+    // if collideBalls is set
+    template <typename Scheme = SemiImplicitEuler>
+    void update(const HeightField& terrain, float frameTime);
+
+private:
+    size_t count;
+
+    // per ball, how long it has stayed within sleepSpeed * sleepDelay of slowX, slowY, slowZ;
+    // padding balls sleep from the start
+    std::vector<float> slowTime;
+    std::vector<float> slowX, slowY, slowZ;
+
+    // per ball terrain query results, reused between updates
+    std::vector<float> terrainHeight;
+    std::vector<float> terrainNormalX, terrainNormalY, terrainNormalZ;
+    // per SimdFloat::width balls, false if every ball is asleep
+    std::vector<unsigned char> blockIsAwake;
+    // per SimdFloat::width balls, false if the height pyramid ruled out a collision
+    std::vector<unsigned char> blockMayCollide;
+
+    // Ball contacts: a uniform grid of cells one ball diameter wide, hashed into a power of two buckets
+    // at least twice the ball count, so each ball only meets the balls in the 27 cells around its own.
+    // cellBalls lists the balls bucket by bucket, bucket b holding cellBalls[bucketStart[b]] up to
+    // cellBalls[bucketStart[b + 1]], with their cells alongside in cellKeys
+    std::vector<uint64_t> ballCell;
+    std::vector<unsigned> bucketStart;
+    std::vector<unsigned> cellBalls;
+    std::vector<uint64_t> cellKeys;
+    // isSleeping() of each ball as the contact pass starts, as the pass itself wakes balls
+    std::vector<unsigned char> wasSleeping;
+
+    // resize every array to hold count balls rounded up to maxLanes
+    void resizeArrays(size_t paddedCount);
+
+    // bounce every pair of touching balls that are closing in, after the balls have moved
+    void collideWithBalls();
+
+    void collidePair(size_t ball, size_t other);
+};
+
+#endif
@@ -0,0 +1,19 @@
+#include "BinaryIO.h"
+
+#include <cstring>
+
+bool hasFileExtension(const char* fileName, const char* extension) {
+    const size_t nameLength = std::strlen(fileName);
+    const size_t extensionLength = std::strlen(extension);
+    return nameLength >= extensionLength && std::strcmp(fileName + nameLength - extensionLength, extension) == 0;
+}
+
+std::uint64_t alignFileOffset(const std::uint64_t offset) {
+    return (offset + binaryFileAlignment - 1) / binaryFileAlignment * binaryFileAlignment;
+}
+
+void padToFileOffset(std::ostream& outStream, const std::uint64_t offset) {
+    while (static_cast<std::uint64_t>(outStream.tellp()) < offset) {
+        outStream.put(0);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <cstdint>
+#include <ostream>
+
+// Helpers shared by the binary file formats
+
+// alignment of the data blocks in every binary file
+constexpr std::uint64_t binaryFileAlignment = 64;
+
+// true if fileName ends with extension, e.g. ".demb"
+bool hasFileExtension(const char* fileName, const char* extension);
+
+// round offset up to the next multiple of binaryFileAlignment
+std::uint64_t alignFileOffset(std::uint64_t offset);
+
+// write zero bytes until the stream reaches offset
+void padToFileOffset(std::ostream& outStream, std::uint64_t offset);
+
+#endif
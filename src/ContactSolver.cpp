@@ -0,0 +1,210 @@
+#include "ContactSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PhysicsConstants.h"
+
+// vertices closer than this above the terrain count as touching, and penetrations shallower than this
+// are left alone, so a resting body keeps its contacts instead of flickering in and out of them
+constexpr float contactSlop = 0.01f;
+
+// fraction of the penetration beyond contactSlop pushed out per step
+constexpr float positionCorrection = 0.2f;
+
+// impacts slower than this do not bounce, so resting contacts do not keep hopping
+constexpr float restitutionThreshold = 1.0f;
+
+// true if point lies over the triangle in x-y, edges included
+static bool liesOverTriangle(const Cartesian3& point, const Cartesian3 corners[3]) {
+    bool hasNegative = false;
+    bool hasPositive = false;
+    for (int edge = 0; edge < 3; edge++) {
+        const Cartesian3& from = corners[edge];
+        const Cartesian3& to = corners[(edge + 1) % 3];
+        const float side = (to.x - from.x) * (point.y - from.y) - (to.y - from.y) * (point.x - from.x);
+        hasNegative |= side < 0.0f;
+        hasPositive |= side > 0.0f;
+    }
+    return !(hasNegative && hasPositive);
+}
+
+// two unit vectors across the normal, always the same ones for the same normal
+static void findTangents(const Cartesian3& normal, Cartesian3 tangents[2]) {
+    const Cartesian3 axis = std::abs(normal.x) < 0.57735f ? Cartesian3(1.0f, 0.0f, 0.0f) : Cartesian3(0.0f, 1.0f, 0.0f);
+    tangents[0] = normal.cross(axis).unit();
+    tangents[1] = normal.cross(tangents[0]);
+}
+
+static void applyImpulse(const RigidBody& body, const Cartesian3& leverArm, const Cartesian3& impulse,
+                         Cartesian3& velocity, Cartesian3& angularVelocity) {
+    velocity = velocity + impulse / body.mass;
+    angularVelocity = angularVelocity + body.angularVelocityChange(leverArm, impulse);
+}
+
+ContactSolver::ContactSolver()
+    : iterations(8),
+      friction(frictionCoefficient),
+      restitution(elasticity),
+      supportHint(-1) {
+}
+
+void ContactSolver::clear() {
+    contacts.clear();
+    previousContacts.clear();
+}
+
+void ContactSolver::findContacts(const Terrain& terrain, const IndexedFaceSurface& model, const RigidBody& body,
+                                 const Cartesian3& position) {
+    previousContacts.swap(contacts);
+    contacts.clear();
+    candidates.clear();
+    if (body.supportMap.empty()) {
+        return;
+    }
+
+    const Cartesian3 centre = position + body.rotation * model.boundingSphereCentre;
+    squares.clear();
+    terrain.findSweptSquares(centre, centre, model.boundingSphereRadius + contactSlop, squares);
+    const Cartesian3 centreOfMass = position + body.rotation * body.centreOfMass;
+    const Matrix3 toBody = body.rotation.transpose();
+
+    for (const long square : squares) {
+        for (long face = 2 * square; face < 2 * square + 2; face++) {
+            const Cartesian3 normal = terrain.faceNormal(face);
+            Cartesian3 corners[3];
+            terrain.faceCorners(face, corners);
+
+            // the support vertex along the downward normal is the deepest below the triangle's plane,
+            // and every vertex touching the plane lies in the cap around it
+            const Cartesian3 offset = body.supportOffset(-normal, supportHint);
+            const float deepest = normal.dot(corners[0] - (position + offset));
+            if (deepest <= -contactSlop) {
+                continue;
+            }
+            cap.clear();
+            body.supportMap.findCap(toBody * -normal, supportHint, deepest + contactSlop, cap);
+
+            for (const int vertex : cap) {
+                const Cartesian3 point = position + body.rotation * body.supportMap.vertex(vertex);
+                const float depth = normal.dot(corners[0] - point);
+                if (depth <= -contactSlop || !liesOverTriangle(point, corners)) {
+                    continue;
+                }
+                // a vertex over the shared edge of two triangles counts once, where it is deeper
+                const auto same = std::find_if(candidates.begin(), candidates.end(),
+                                               [vertex](const ContactPoint& candidate) {
+                                                   return candidate.vertex == vertex;
+                                               });
+                if (same != candidates.end() && same->depth >= depth) {
+                    continue;
+                }
+                ContactPoint contact{};
+                contact.vertex = vertex;
+                contact.leverArm = point - centreOfMass;
+                contact.normal = normal;
+                contact.depth = depth;
+                if (same != candidates.end()) {
+                    *same = contact;
+                } else {
+                    candidates.push_back(contact);
+                }
+            }
+        }
+    }
+
+    reduceCandidates();
+
+    // contacts on the same vertex as last step start from last step's impulses
+    for (auto& contact : contacts) {
+        findTangents(contact.normal, contact.tangents);
+        for (const auto& previous : previousContacts) {
+            if (previous.vertex == contact.vertex) {
+                contact.normalImpulse = previous.normalImpulse;
+                contact.tangentImpulses[0] = previous.tangentImpulses[0];
+                contact.tangentImpulses[1] = previous.tangentImpulses[1];
+                break;
+            }
+        }
+    }
+}
+
+void ContactSolver::reduceCandidates() {
+    if (candidates.size() <= maxContacts) {
+        contacts = candidates;
+        return;
+    }
+
+    // deepest first, then the farthest from it, then the widest triangle, then the widest quadrilateral
+    const auto pick = [&](const auto& score) {
+        auto best = std::max_element(candidates.begin(), candidates.end(),
+                                     [&](const ContactPoint& first, const ContactPoint& second) {
+                                         return score(first) < score(second);
+                                     });
+        contacts.push_back(*best);
+        candidates.erase(best);
+    };
+    pick([](const ContactPoint& candidate) { return candidate.depth; });
+    const Cartesian3 a = contacts[0].leverArm;
+    pick([&](const ContactPoint& candidate) { return (candidate.leverArm - a).dot(candidate.leverArm - a); });
+    const Cartesian3 b = contacts[1].leverArm;
+    pick([&](const ContactPoint& candidate) { return (b - a).cross(candidate.leverArm - a).length(); });
+    const Cartesian3 c = contacts[2].leverArm;
+    pick([&](const ContactPoint& candidate) {
+        const Cartesian3 p = candidate.leverArm;
+        return std::max({(a - p).cross(b - p).length(), (b - p).cross(c - p).length(), (c - p).cross(a - p).length()});
+    });
+}
+
+float ContactSolver::solve(const RigidBody& body, Cartesian3& velocity, Cartesian3& angularVelocity, const float dt) {
+    const float inverseDt = dt > 0.0f ? 1.0f / dt : 0.0f;
+
+    float approachSpeed = 0.0f;
+    for (auto& contact : contacts) {
+        contact.normalMass = 1.0f / body.inverseMassAlong(contact.leverArm, contact.normal);
+        for (int tangent = 0; tangent < 2; tangent++) {
+            contact.tangentMasses[tangent] = 1.0f / body.inverseMassAlong(contact.leverArm, contact.tangents[tangent]);
+        }
+
+        // push out of the terrain over a few steps, and bounce off hard impacts
+        const float normalSpeed = (velocity + angularVelocity.cross(contact.leverArm)).dot(contact.normal);
+        approachSpeed = std::max(approachSpeed, -normalSpeed);
+        contact.targetSpeed = positionCorrection * inverseDt * std::max(contact.depth - contactSlop, 0.0f);
+        if (normalSpeed < -restitutionThreshold) {
+            contact.targetSpeed = std::max(contact.targetSpeed, -restitution * normalSpeed);
+        }
+
+        applyImpulse(body, contact.leverArm,
+                     contact.normal * contact.normalImpulse + contact.tangents[0] * contact.tangentImpulses[0] +
+                     contact.tangents[1] * contact.tangentImpulses[1],
+                     velocity, angularVelocity);
+    }
+
+    // Accumulated impulses are clamped, not each correction, so a pass can take back
+    // what an earlier one overdid
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (auto& contact : contacts) {
+            // friction first, bounded by the normal impulse so far
+            const float limit = friction * contact.normalImpulse;
+            for (int tangent = 0; tangent < 2; tangent++) {
+                const Cartesian3& direction = contact.tangents[tangent];
+                const float tangentSpeed = (velocity + angularVelocity.cross(contact.leverArm)).dot(direction);
+                const float impulse = std::clamp(contact.tangentImpulses[tangent] -
+                                                 tangentSpeed * contact.tangentMasses[tangent], -limit, limit);
+                applyImpulse(body, contact.leverArm, direction * (impulse - contact.tangentImpulses[tangent]),
+                             velocity, angularVelocity);
+                contact.tangentImpulses[tangent] = impulse;
+            }
+
+            // the terrain can only push
+            const float normalSpeed = (velocity + angularVelocity.cross(contact.leverArm)).dot(contact.normal);
+            const float impulse = std::max(contact.normalImpulse +
+                                           (contact.targetSpeed - normalSpeed) * contact.normalMass, 0.0f);
+            applyImpulse(body, contact.leverArm, contact.normal * (impulse - contact.normalImpulse),
+                         velocity, angularVelocity);
+            contact.normalImpulse = impulse;
+        }
+    }
+
+    return approachSpeed;
+}
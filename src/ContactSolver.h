@@ -0,0 +1,82 @@
+#ifndef CONTACT_SOLVER_H
+#define CONTACT_SOLVER_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+#include "IndexedFaceSurface.h"
+#include "RigidBody.h"
+#include "Terrain.h"
+
+// one point where a polyhedral ball touches the terrain
+struct ContactPoint {
+    // support map vertex touching, which identifies the contact from one step to the next
+    int vertex;
+    // world space, from the centre of mass to the vertex
+    Cartesian3 leverArm;
+    // terrain normal, pointing out of the terrain
+    Cartesian3 normal;
+    // two unit vectors across the normal, for friction
+    Cartesian3 tangents[2];
+    // how far the vertex is below the terrain, negative if just above it
+    float depth;
+
+    // impulses accumulated by the solver, carried over to the next step to start from
+    float normalImpulse;
+    float tangentImpulses[2];
+
+    // per step constants of the solver
+    float normalMass;
+    float tangentMasses[2];
+    float targetSpeed;
+};
+
+// Contacts of one convex polyhedral body with the terrain, up to four of them (the contact manifold),
+// resolved together by sequential impulses: every contact in turn gets the impulse that corrects
+// its own velocity, and a few passes over all of them converge on impulses that satisfy them all at once.
+// Starting each step from the previous step's impulses (warm starting) lets a resting body settle
+// in a step or two instead of bouncing between its contacts. Friction is Coulomb friction along
+// two tangents, bounded by the normal impulse.
+class ContactSolver {
+public:
+    static constexpr int maxContacts = 4;
+
+    // solver passes per step
+    int iterations;
+    // Coulomb friction coefficient
+    float friction;
+    // normal speed kept after an impact, as a fraction of the approach speed
+    float restitution;
+
+    ContactSolver();
+
+    // forget the contacts of the previous step, e.g. when the body is moved by hand
+    void clear();
+
+    // Find the contacts of body, shaped like model and placed at position with its current orientation,
+    // with the terrain triangles under its bounding sphere, reduced to the maxContacts that span the most area.
+    // Impulses of contacts that persist from the previous step are kept for warm starting
+    void findContacts(const Terrain& terrain, const IndexedFaceSurface& model, const RigidBody& body,
+                      const Cartesian3& position);
+
+    int contactCount() const { return static_cast<int>(contacts.size()); }
+
+    // Apply the impulses that stop every contact from closing in, bounce impacts and add friction,
+    // over a step of dt seconds. Returns the fastest speed at which a contact was approaching
+    float solve(const RigidBody& body, Cartesian3& velocity, Cartesian3& angularVelocity, float dt);
+
+private:
+    std::vector<ContactPoint> contacts;
+    std::vector<ContactPoint> previousContacts;
+
+    // scratch, kept to avoid allocating every step
+    std::vector<long> squares;
+    std::vector<int> cap;
+    std::vector<ContactPoint> candidates;
+    int supportHint;
+
+    // keep the deepest candidate and the ones spreading the manifold the widest
+    void reduceCandidates();
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "Geometry.h"
+
+bool intersectRayTriangle(const Cartesian3& origin, const Cartesian3& direction, const Cartesian3 corners[3],
+                          float& t) {
+    // Moller-Trumbore: solve origin + t * direction = corner 0 + u * edge 1 + v * edge 2
+    const Cartesian3 edge1 = corners[1] - corners[0];
+    const Cartesian3 edge2 = corners[2] - corners[0];
+    const Cartesian3 p = direction.cross(edge2);
+    const float determinant = edge1.dot(p);
+    if (determinant == 0.0f) {
+        // parallel to the triangle
+        return false;
+    }
+    const float inverse = 1.0f / determinant;
+    const Cartesian3 offset = origin - corners[0];
+    const float u = offset.dot(p) * inverse;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    const Cartesian3 q = offset.cross(edge1);
+    const float v = direction.dot(q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    t = edge2.dot(q) * inverse;
+    return true;
+}
@@ -0,0 +1,11 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "Cartesian3.h"
+
+// Parameter t at which the ray origin + t * direction crosses the triangle of the three corners,
+// from either side. False if it misses or runs parallel to the triangle; t may be negative
+bool intersectRayTriangle(const Cartesian3& origin, const Cartesian3& direction, const Cartesian3 corners[3],
+                          float& t);
+
+#endif
@@ -0,0 +1,16 @@
+#include "HeightField.h"
+
+#include <algorithm>
+
+bool HeightField::maySweepHit(const Cartesian3& start, const Cartesian3& end, const float radius) const {
+    return mayReach(std::min(start.x, end.x) - radius, std::min(start.y, end.y) - radius,
+                    std::max(start.x, end.x) + radius, std::max(start.y, end.y) + radius,
+                    std::min(start.z, end.z) - radius);
+}
+
+void HeightField::prefetch(const Cartesian3&, const Cartesian3&, float) const {
+}
+
+const Terrain* HeightField::asTerrain() const {
+    return nullptr;
+}
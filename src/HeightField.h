@@ -0,0 +1,54 @@
+#ifndef HEIGHT_FIELD_H
+#define HEIGHT_FIELD_H
+
+#include <cstddef>
+
+#include "Cartesian3.h"
+
+class Terrain;
+
+// The height and normal queries a sphere needs from the ground, answered both by the in-memory
+// Terrain and by the file-backed PagedTerrain. Positions are centred on the grid's middle row and
+// column; points off the grid take the height and normal of the nearest point on its edge.
+// Every query is const and safe to call from many threads at once.
+class HeightField {
+public:
+    virtual ~HeightField() = default;
+
+    // query height at a given (x, y) coordinate
+    virtual float getHeight(float x, float y) const = 0;
+
+    // unit normal of the triangle under (x, y)
+    virtual Cartesian3 getNormal(float x, float y) const = 0;
+
+    // height and normal at (x, y), looking the grid square up once
+    virtual void getHeightAndNormal(float x, float y, float& height, Cartesian3& normal) const = 0;
+
+    // count points given as separate x and y arrays, normals written as separate x, y and z arrays
+    virtual void getHeightsAndNormals(const float* x, const float* y, size_t count, float* heights,
+                                      float* normalX, float* normalY, float* normalZ) const = 0;
+
+    // true if (x, y) lies over the grid, i.e. getHeight and getNormal are valid there
+    virtual bool contains(float x, float y) const = 0;
+
+    // the x-y rectangle contains() accepts, minimum included and maximum excluded
+    virtual void getExtent(float& minX, float& minY, float& maxX, float& maxY) const = 0;
+
+    // False if the ground stays below height everywhere over the x-y box. Conservative and cheap:
+    // true only means a lookup is needed
+    virtual bool mayReach(float minX, float minY, float maxX, float maxY, float height) const = 0;
+
+    // False if a sphere of the given radius moving from start to end cannot touch the ground,
+    // because its lowest point stays above everything mayReach finds under its path
+    bool maySweepHit(const Cartesian3& start, const Cartesian3& end, float radius) const;
+
+    // Hint that a point will move from position along velocity for the next lookahead seconds,
+    // so that the data under that path can be read ahead. Does nothing unless overridden
+    virtual void prefetch(const Cartesian3& position, const Cartesian3& velocity, float lookahead) const;
+
+    // the in-memory terrain with its triangles, for the queries only it answers (sweepSphere,
+    // findSweptSquares, faceCorners), or null
+    virtual const Terrain* asTerrain() const;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "HeightGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// round count up to whole blocks of 2^bits
+static long roundUpToBlocks(const long count, const long bits) {
+    return ((count + (1L << bits) - 1) >> bits) << bits;
+}
+
+HeightGrid::HeightGrid()
+    : nRows(0),
+      nColumns(0),
+      gridLayout(HeightGridLayout::RowMajor),
+      blocksPerRow(0),
+      gridEncoding(HeightGridEncoding::Float32),
+      rangesPerRow(0),
+      quantizationErrors{0.0f, 0.0f, 0.0f} {
+}
+
+void HeightGrid::resize(const long rows, const long columns, const HeightGridLayout layout) {
+    nRows = rows;
+    nColumns = columns;
+    gridLayout = layout;
+
+    long paddedRows = rows, paddedColumns = columns;
+    if (layout != HeightGridLayout::RowMajor) {
+        const long bits = layout == HeightGridLayout::Tiled ? heightTileBits : heightBlockBits;
+        paddedRows = roundUpToBlocks(rows, bits);
+        paddedColumns = roundUpToBlocks(columns, bits);
+        blocksPerRow = paddedColumns >> bits;
+    } else {
+        blocksPerRow = 0;
+    }
+
+    // drop the old contents first so that a shrink does not keep the old allocation
+    values = std::vector<float>(static_cast<size_t>(paddedRows) * paddedColumns, 0.0f);
+    gridEncoding = HeightGridEncoding::Float32;
+    codes = std::vector<std::uint16_t>();
+    blockRanges = std::vector<float>();
+    rangesPerRow = 0;
+    quantizationErrors = {0.0f, 0.0f, 0.0f};
+}
+
+void HeightGrid::setLayout(const HeightGridLayout layout) {
+    if (layout == gridLayout) {
+        return;
+    }
+    // reordered as floats, then quantized again, which keeps the same block ranges
+    const HeightGridEncoding encoding = gridEncoding;
+    setEncoding(HeightGridEncoding::Float32);
+
+    HeightGrid reordered;
+    reordered.resize(nRows, nColumns, layout);
+    std::vector<float> rowValues(nColumns);
+    for (long row = 0; row < nRows; row++) {
+        getRow(row, rowValues.data());
+        reordered.setRow(row, rowValues.data());
+    }
+    *this = std::move(reordered);
+    setEncoding(encoding);
+}
+
+void HeightGrid::setEncoding(const HeightGridEncoding encoding) {
+    if (encoding == gridEncoding) {
+        return;
+    }
+    if (encoding == HeightGridEncoding::Quantized16) {
+        quantize();
+    } else {
+        dequantize();
+    }
+    gridEncoding = encoding;
+}
+
+size_t HeightGrid::storageBytes() const {
+    return values.size() * sizeof(float) + codes.size() * sizeof(std::uint16_t) + blockRanges.size() * sizeof(float);
+}
+
+void HeightGrid::quantize() {
+    constexpr float maxCode = std::numeric_limits<std::uint16_t>::max();
+    rangesPerRow = roundUpToBlocks(nColumns, heightBlockBits) >> heightBlockBits;
+    const size_t blockCount = (roundUpToBlocks(nRows, heightBlockBits) >> heightBlockBits) * rangesPerRow;
+
+    // lowest height and, until the steps are worked out, highest height of every block
+    blockRanges.assign(2 * blockCount, 0.0f);
+    for (size_t block = 0; block < blockCount; block++) {
+        blockRanges[2 * block] = std::numeric_limits<float>::max();
+        blockRanges[2 * block + 1] = std::numeric_limits<float>::lowest();
+    }
+    for (long row = 0; row < nRows; row++) {
+        for (long column = 0; column < nColumns; column++) {
+            const float height = values[index(row, column)];
+            float* range = blockRanges.data() + rangeIndex(row, column);
+            range[0] = std::min(range[0], height);
+            range[1] = std::max(range[1], height);
+        }
+    }
+    float maximumStep = 0.0f;
+    for (size_t block = 0; block < blockCount; block++) {
+        blockRanges[2 * block + 1] = (blockRanges[2 * block + 1] - blockRanges[2 * block]) / maxCode;
+        maximumStep = std::max(maximumStep, blockRanges[2 * block + 1]);
+    }
+
+    codes.assign(values.size() + 1, 0);
+    float maximumError = 0.0f;
+    double squaredErrors = 0.0;
+    for (long row = 0; row < nRows; row++) {
+        for (long column = 0; column < nColumns; column++) {
+            const size_t value = index(row, column);
+            const float* range = blockRanges.data() + rangeIndex(row, column);
+            // a flat block has a step of zero and every code zero
+            const float code = range[1] > 0.0f ? std::min(std::round((values[value] - range[0]) / range[1]), maxCode)
+                                               : 0.0f;
+            codes[value] = static_cast<std::uint16_t>(code);
+            const float error = std::abs(range[0] + code * range[1] - values[value]);
+            maximumError = std::max(maximumError, error);
+            squaredErrors += static_cast<double>(error) * error;
+        }
+    }
+    quantizationErrors.maximum = maximumError;
+    quantizationErrors.rms = static_cast<float>(std::sqrt(squaredErrors / (static_cast<double>(nRows) * nColumns)));
+    quantizationErrors.maximumStep = maximumStep;
+
+    values = std::vector<float>();
+}
+
+void HeightGrid::dequantize() {
+    values.assign(codes.size() - 1, 0.0f);
+    for (long row = 0; row < nRows; row++) {
+        for (long column = 0; column < nColumns; column++) {
+            const float* range = blockRanges.data() + rangeIndex(row, column);
+            values[index(row, column)] = range[0] + static_cast<float>(codes[index(row, column)]) * range[1];
+        }
+    }
+    codes = std::vector<std::uint16_t>();
+    blockRanges = std::vector<float>();
+    rangesPerRow = 0;
+    quantizationErrors = {0.0f, 0.0f, 0.0f};
+}
+
+void HeightGrid::getRow(const long row, float* rowValues) const {
+    if (gridLayout == HeightGridLayout::RowMajor && gridEncoding == HeightGridEncoding::Float32) {
+        std::memcpy(rowValues, values.data() + row * nColumns, nColumns * sizeof(float));
+        return;
+    }
+    for (long column = 0; column < nColumns; column++) {
+        rowValues[column] = (*this)(row, column);
+    }
+}
+
+void HeightGrid::setRow(const long row, const float* rowValues) {
+    if (gridLayout == HeightGridLayout::RowMajor) {
+        std::memcpy(values.data() + row * nColumns, rowValues, nColumns * sizeof(float));
+        return;
+    }
+    for (long column = 0; column < nColumns; column++) {
+        (*this)(row, column) = rowValues[column];
+    }
+}
+
+bool HeightGrid::operator==(const HeightGrid& other) const {
+    if (nRows != other.nRows || nColumns != other.nColumns) {
+        return false;
+    }
+    if (gridLayout == other.gridLayout && gridEncoding == HeightGridEncoding::Float32 &&
+        other.gridEncoding == HeightGridEncoding::Float32) {
+        return values == other.values;
+    }
+    for (long row = 0; row < nRows; row++) {
+        for (long column = 0; column < nColumns; column++) {
+            if ((*this)(row, column) != other(row, column)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
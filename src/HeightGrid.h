@@ -0,0 +1,359 @@
+#ifndef HEIGHT_GRID_H
+#define HEIGHT_GRID_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Simd.h"
+
+// How a HeightGrid orders its values in memory.
+enum class HeightGridLayout {
+    // row after row, as in the files
+    RowMajor,
+    // 4 x 4 tiles of one 64-byte cache line each, tiles row after row
+    Tiled,
+    // 32 x 32 blocks of one 4 KB page each, blocks row after row, Z-order inside a block
+    Morton
+};
+
+// How a HeightGrid stores each height.
+enum class HeightGridEncoding {
+    // float32, exactly as read
+    Float32,
+    // uint16 steps between the lowest and highest height of each 32 x 32 block of heights,
+    // half the memory at an error of at most half a step
+    Quantized16
+};
+
+// how far quantized heights are from the floats they were made from
+struct HeightQuantizationError {
+    float maximum;
+    float rms;
+    // largest step of any block, twice the worst case error
+    float maximumStep;
+};
+
+// the four heights at the corners of one grid square
+struct HeightSquare {
+    float topLeft;
+    float topRight;
+    float bottomLeft;
+    float bottomRight;
+};
+
+// Rows x columns heights in one contiguous allocation.
+// In the Tiled and Morton layouts the 2 x 2 corners of a square share a cache line unless
+// the square straddles a tile edge; rows and columns are padded to whole tiles or blocks.
+class HeightGrid {
+public:
+    HeightGrid();
+
+    // resize to rows x columns in the given layout, all heights zero
+    void resize(long rows, long columns, HeightGridLayout layout);
+
+    // reorder the values into another layout
+    void setLayout(HeightGridLayout layout);
+
+    // Re-encode the values, measuring the error when quantizing.
+    // Only a Float32 grid can be written to; resize always makes one
+    void setEncoding(HeightGridEncoding encoding);
+
+    long rows() const { return nRows; }
+    long columns() const { return nColumns; }
+    HeightGridLayout layout() const { return gridLayout; }
+    HeightGridEncoding encoding() const { return gridEncoding; }
+    // error of the last quantization, zero for a Float32 grid
+    const HeightQuantizationError& quantizationError() const { return quantizationErrors; }
+    // bytes held by the heights and their quantization ranges
+    size_t storageBytes() const;
+    bool empty() const { return nRows == 0; }
+
+    // position of (row, column) in data(), or among the quantized codes
+    size_t index(long row, long column) const;
+
+    // writable height, Float32 only
+    float& operator()(long row, long column) { return values[index(row, column)]; }
+    float operator()(long row, long column) const;
+
+#ifdef SIMD_HAS_GATHER
+    // index() per lane, for grids of fewer than 2^31 values
+    SimdInt index(const SimdInt& row, const SimdInt& column) const;
+
+    // heights per lane, decoded
+    SimdFloat gather(const SimdInt& row, const SimdInt& column) const;
+#endif
+
+    // corners of the square whose top left is (row, column)
+    HeightSquare square(long row, long column) const;
+
+    // copy one row in or out, whatever the layout (in: Float32 only)
+    void getRow(long row, float* rowValues) const;
+    void setRow(long row, const float* rowValues);
+
+    // all values including padding, in layout order, Float32 only
+    float* data() { return values.data(); }
+    const float* data() const { return values.data(); }
+
+    // same dimensions and heights, regardless of layout
+    bool operator==(const HeightGrid& other) const;
+    bool operator!=(const HeightGrid& other) const { return !(*this == other); }
+
+private:
+    std::vector<float> values;
+    long nRows;
+    long nColumns;
+    HeightGridLayout gridLayout;
+    // tiles or blocks per padded row, unused for RowMajor
+    long blocksPerRow;
+
+    HeightGridEncoding gridEncoding;
+    // Quantized16 only: one code per value, plus one so that gathers can read 32 bits at the last one,
+    // and the lowest height and step of every 32 x 32 block of the grid, whatever the layout
+    std::vector<std::uint16_t> codes;
+    std::vector<float> blockRanges;
+    long rangesPerRow;
+    HeightQuantizationError quantizationErrors;
+
+    // position of the quantization range of (row, column) in blockRanges
+    size_t rangeIndex(long row, long column) const;
+
+    void quantize();
+    void dequantize();
+};
+
+// 4 x 4 floats per tile
+constexpr long heightTileBits = 2;
+// 32 x 32 floats per Morton block
+constexpr long heightBlockBits = 5;
+
+// interleave the bits of row and column (below 256 each), column in the even bits
+inline size_t mortonIndex(const long row, const long column) {
+    const auto spread = [](size_t value) {
+        value = (value | (value << 4)) & 0x0F0F;
+        value = (value | (value << 2)) & 0x3333;
+        value = (value | (value << 1)) & 0x5555;
+        return value;
+    };
+    return spread(column) | (spread(row) << 1);
+}
+
+inline size_t HeightGrid::index(const long row, const long column) const {
+    switch (gridLayout) {
+    case HeightGridLayout::Tiled: {
+        constexpr long tileMask = (1 << heightTileBits) - 1;
+        const size_t tile = (row >> heightTileBits) * blocksPerRow + (column >> heightTileBits);
+        return (tile << (2 * heightTileBits)) + ((row & tileMask) << heightTileBits) + (column & tileMask);
+    }
+    case HeightGridLayout::Morton: {
+        constexpr long blockMask = (1 << heightBlockBits) - 1;
+        const size_t block = (row >> heightBlockBits) * blocksPerRow + (column >> heightBlockBits);
+        return (block << (2 * heightBlockBits)) + mortonIndex(row & blockMask, column & blockMask);
+    }
+    default:
+        return row * nColumns + column;
+    }
+}
+
+inline size_t HeightGrid::rangeIndex(const long row, const long column) const {
+    return 2 * ((row >> heightBlockBits) * rangesPerRow + (column >> heightBlockBits));
+}
+
+inline float HeightGrid::operator()(const long row, const long column) const {
+    if (gridEncoding == HeightGridEncoding::Float32) {
+        return values[index(row, column)];
+    }
+    const float* range = blockRanges.data() + rangeIndex(row, column);
+    return range[0] + static_cast<float>(codes[index(row, column)]) * range[1];
+}
+
+// Height at (xRemainder, yRemainder) inside a square, (0, 0) at its top left and (1, 1) at its bottom right,
+// on the two triangles the square is split into along that diagonal
+inline float squareHeight(const HeightSquare& corners, const float xRemainder, const float yRemainder) {
+    // OK. There are two possibilities - above or below the TL-BR diagonal
+    // Since this is the line x = y, it's easy to check
+    if (xRemainder < yRemainder) {
+        // LL triangle
+        // in theory, we want barycentric interpolation, but fortunately, it collapses for us because we have
+        // right triangles.
+        // y_remainder is alpha, the barycentric coordinate for the UL corner
+        // (1.0 - y_remainder) * x_remainder is beta, the barycentric coordinate for the LR corner
+        // (1.0 - y_remainder) * (1.0 - x_remainder) is gamma, the barycentric coordinate for the LL corner
+        const float alpha = yRemainder;
+        const float beta = (1.0 - yRemainder) * xRemainder;
+        const float gamma = 1.0 - alpha - beta;
+
+        // compute and return
+        return alpha * corners.topLeft +
+               beta * corners.bottomRight +
+               gamma * corners.bottomLeft;
+    }
+
+    // UR triangle
+    // (1.0 - x_remainder) is alpha, the barycentric coordinate for the UL corner
+    // x_remainder * y_remainder is beta, the barycentric coordinate for the LR corner
+    // x_remainder * (1.0 - y_remainder) is gamma, the barycentric coordinate for the UR corner
+    const float alpha = 1.0 - yRemainder;
+    const float beta = xRemainder * yRemainder;
+    const float gamma = 1.0 - alpha - beta;
+
+    return alpha * corners.topLeft +
+           beta * corners.bottomRight +
+           gamma * corners.topRight;
+}
+
+// grid square a point lies over, and where inside it
+struct GridCell {
+    long row;
+    long column;
+    float xRemainder;
+    float yRemainder;
+};
+
+// value clamped to [0, limit], NaN going to 0
+inline float clampToGrid(const float value, const float limit) {
+    return value > 0.0f ? std::min(value, limit) : 0.0f;
+}
+
+// Grid square under (x, y) on rows x columns heights xyScale apart, with (0, 0) at the middle row and
+// column and row 0 at the top. Points off the grid, NaN included, take the nearest point on its edge
+inline GridCell findGridCell(float x, float y, const long rows, const long columns, const float xyScale) {
+    const long totalHeight = (rows - 1) * xyScale;
+
+    // (0,0) is at the dead centre given the layout of the data
+    // It is located at x = nRows / 2 (integer), y = nRows / 2 (integer)
+    const long i = rows / 2;
+    const long j = columns / 2;
+
+    // correct x and y for this offset (note rows are y, columns are x)
+    x = x + j * xyScale;
+    y = y + i * xyScale;
+
+    // we need to flip coordinates vertically because the rows start at the top
+    y = totalHeight - y;
+
+    // Clamp onto the grid while still in floating point, so a point off its edges takes the height of
+    // the nearest edge point and a huge or NaN coordinate never reaches the conversion to long
+    x = clampToGrid(x, (columns - 1) * xyScale);
+    y = clampToGrid(y, (rows - 1) * xyScale);
+
+    // now divide by the x-y scale to get the index
+    const long xInteger = x / xyScale;
+    const long yInteger = y / xyScale;
+
+    // the row and column of the square; the last row and column of heights have none of their own
+    GridCell cell;
+    cell.row = std::min(yInteger, rows - 2);
+    cell.column = std::min(xInteger, columns - 2);
+
+    // work out the fractional parts, up to 1 on the last row and column
+    cell.xRemainder = (x - xyScale * cell.column) / xyScale;
+    cell.yRemainder = (y - xyScale * cell.row) / xyScale;
+
+    return cell;
+}
+
+// true if (x, y) lies over a square of the grid findGridCell describes
+inline bool gridContains(float x, float y, const long rows, const long columns, const float xyScale) {
+    if (rows < 2) {
+        return false;
+    }
+
+    // same offset and flip as findGridCell
+    const long totalHeight = (rows - 1) * xyScale;
+    x = x + (columns / 2) * xyScale;
+    y = totalHeight - (y + (rows / 2) * xyScale);
+
+    // the last row and column have no square of their own
+    return x >= 0.0f && x < (columns - 1) * xyScale &&
+           y >= 0.0f && y < (rows - 1) * xyScale;
+}
+
+// the x-y rectangle gridContains() accepts, minimum included and maximum excluded
+inline void gridExtent(const long rows, const long columns, const float xyScale,
+                       float& minX, float& minY, float& maxX, float& maxY) {
+    // gridContains() solved for x and y
+    const long totalHeight = (rows - 1) * xyScale;
+    minX = -(columns / 2) * xyScale;
+    maxX = minX + (columns - 1) * xyScale;
+    maxY = totalHeight - (rows / 2) * xyScale;
+    minY = maxY - (rows - 1) * xyScale;
+}
+
+#ifdef SIMD_HAS_GATHER
+inline SimdInt HeightGrid::index(const SimdInt& row, const SimdInt& column) const {
+    switch (gridLayout) {
+    case HeightGridLayout::Tiled: {
+        const SimdInt tileMask((1 << heightTileBits) - 1);
+        const SimdInt tile = (row >> heightTileBits) * SimdInt(static_cast<int>(blocksPerRow)) + (column >> heightTileBits);
+        return (tile << (2 * heightTileBits)) + ((row & tileMask) << heightTileBits) + (column & tileMask);
+    }
+    case HeightGridLayout::Morton: {
+        const SimdInt blockMask((1 << heightBlockBits) - 1);
+        const auto spread = [](SimdInt value) {
+            value = (value | (value << 4)) & SimdInt(0x0F0F);
+            value = (value | (value << 2)) & SimdInt(0x3333);
+            value = (value | (value << 1)) & SimdInt(0x5555);
+            return value;
+        };
+        const SimdInt block = (row >> heightBlockBits) * SimdInt(static_cast<int>(blocksPerRow)) + (column >> heightBlockBits);
+        return (block << (2 * heightBlockBits)) + (spread(column & blockMask) | (spread(row & blockMask) << 1));
+    }
+    default:
+        return row * SimdInt(static_cast<int>(nColumns)) + column;
+    }
+}
+
+inline SimdFloat HeightGrid::gather(const SimdInt& row, const SimdInt& column) const {
+    const SimdInt valueIndex = index(row, column);
+    if (gridEncoding == HeightGridEncoding::Float32) {
+        return SimdFloat::gather(values.data(), valueIndex);
+    }
+    const SimdInt range = ((row >> heightBlockBits) * SimdInt(static_cast<int>(rangesPerRow)) +
+                           (column >> heightBlockBits)) << 1;
+    const SimdFloat lowest = SimdFloat::gather(blockRanges.data(), range);
+    const SimdFloat step = SimdFloat::gather(blockRanges.data(), range + SimdInt(1));
+    return lowest + SimdInt::gather(codes.data(), valueIndex).toFloat() * step;
+}
+#endif
+
+inline HeightSquare HeightGrid::square(const long row, const long column) const {
+    if (gridEncoding != HeightGridEncoding::Float32) {
+        return {(*this)(row, column), (*this)(row, column + 1), (*this)(row + 1, column), (*this)(row + 1, column + 1)};
+    }
+    if (gridLayout == HeightGridLayout::RowMajor) {
+        const float* top = values.data() + row * nColumns + column;
+        return {top[0], top[1], top[nColumns], top[nColumns + 1]};
+    }
+
+    // corners inside one tile, or on an even square of a Morton block, sit at fixed offsets
+    constexpr long tileMask = (1 << heightTileBits) - 1;
+    if (gridLayout == HeightGridLayout::Tiled && (row & tileMask) != tileMask && (column & tileMask) != tileMask) {
+        const float* topLeft = values.data() + index(row, column);
+        return {topLeft[0], topLeft[1], topLeft[1 << heightTileBits], topLeft[(1 << heightTileBits) + 1]};
+    }
+    constexpr long blockMask = (1 << heightBlockBits) - 1;
+    if (gridLayout == HeightGridLayout::Morton && ((row | column) & 1) == 0) {
+        const float* topLeft = values.data() + index(row, column);
+        return {topLeft[0], topLeft[1], topLeft[2], topLeft[3]};
+    }
+    if (gridLayout == HeightGridLayout::Morton && (row & blockMask) != blockMask &&
+        (column & blockMask) != blockMask) {
+        // step one column or row by incrementing only the column or row bits of the Morton index
+        constexpr size_t columnBits = 0x155, rowBits = 0x2AA;
+        const size_t topLeft = mortonIndex(row & blockMask, column & blockMask);
+        const size_t topRight = (((topLeft | rowBits) + 1) & columnBits) | (topLeft & rowBits);
+        const size_t bottomLeft = (((topLeft | columnBits) + 1) & rowBits) | (topLeft & columnBits);
+        const size_t bottomRight = (((bottomLeft | rowBits) + 1) & columnBits) | (bottomLeft & rowBits);
+        const float* block = values.data() +
+                             (((row >> heightBlockBits) * blocksPerRow + (column >> heightBlockBits))
+                              << (2 * heightBlockBits));
+        return {block[topLeft], block[topRight], block[bottomLeft], block[bottomRight]};
+    }
+
+    // otherwise the square straddles tiles or Morton quads
+    return {(*this)(row, column), (*this)(row, column + 1), (*this)(row + 1, column), (*this)(row + 1, column + 1)};
+}
+
+#endif
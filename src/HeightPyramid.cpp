@@ -0,0 +1,168 @@
+#include "HeightPyramid.h"
+
+#include <algorithm>
+
+// extremes of the four corners of one square
+static HeightRange squareRange(const HeightGrid& heights, const long row, const long column) {
+    const HeightSquare corners = heights.square(row, column);
+    return {std::min({corners.topLeft, corners.topRight, corners.bottomLeft, corners.bottomRight}),
+            std::max({corners.topLeft, corners.topRight, corners.bottomLeft, corners.bottomRight})};
+}
+
+HeightPyramid::HeightPyramid() : nSquareRows(0), nSquareColumns(0) {
+}
+
+void HeightPyramid::build(const HeightGrid& heights) {
+    levels.clear();
+    nSquareRows = 0;
+    nSquareColumns = 0;
+    if (heights.rows() < 2 || heights.columns() < 2) {
+        return;
+    }
+    nSquareRows = heights.rows() - 1;
+    nSquareColumns = heights.columns() - 1;
+
+    // every level merges 2 x 2 entries of the one below, odd edges merging fewer;
+    // level 1 straight from the corners of its squares
+    long belowRows = nSquareRows;
+    long belowColumns = nSquareColumns;
+    while (belowRows > 1 || belowColumns > 1) {
+        const size_t belowLevel = levels.size();
+        Level coarser;
+        coarser.rows = (belowRows + 1) / 2;
+        coarser.columns = (belowColumns + 1) / 2;
+        coarser.minima.resize(coarser.rows * coarser.columns);
+        coarser.maxima.resize(coarser.rows * coarser.columns);
+        for (long row = 0; row < coarser.rows; row++) {
+            for (long column = 0; column < coarser.columns; column++) {
+                const long lastRow = std::min(2 * row + 1, belowRows - 1);
+                const long lastColumn = std::min(2 * column + 1, belowColumns - 1);
+                HeightRange merged = entry(heights, belowLevel, 2 * row, 2 * column);
+                for (long childRow = 2 * row; childRow <= lastRow; childRow++) {
+                    for (long childColumn = 2 * column; childColumn <= lastColumn; childColumn++) {
+                        const HeightRange child = entry(heights, belowLevel, childRow, childColumn);
+                        merged.minimum = std::min(merged.minimum, child.minimum);
+                        merged.maximum = std::max(merged.maximum, child.maximum);
+                    }
+                }
+                coarser.minima[row * coarser.columns + column] = merged.minimum;
+                coarser.maxima[row * coarser.columns + column] = merged.maximum;
+            }
+        }
+        belowRows = coarser.rows;
+        belowColumns = coarser.columns;
+        levels.push_back(std::move(coarser));
+    }
+}
+
+size_t HeightPyramid::storageBytes() const {
+    size_t bytes = 0;
+    for (const Level& level : levels) {
+        bytes += (level.minima.size() + level.maxima.size()) * sizeof(float);
+    }
+    return bytes;
+}
+
+long HeightPyramid::squareRows() const {
+    return nSquareRows;
+}
+
+long HeightPyramid::squareColumns() const {
+    return nSquareColumns;
+}
+
+HeightRange HeightPyramid::entry(const HeightGrid& heights, const size_t level, const long row,
+                                 const long column) const {
+    if (level == 0) {
+        return squareRange(heights, row, column);
+    }
+    const Level& blocks = levels[level - 1];
+    return {blocks.minima[row * blocks.columns + column], blocks.maxima[row * blocks.columns + column]};
+}
+
+size_t HeightPyramid::levelSpanning(const long firstRow, const long firstColumn,
+                                    const long lastRow, const long lastColumn) const {
+    const long span = std::max(lastRow - firstRow, lastColumn - firstColumn);
+    size_t level = 0;
+    while (level < levels.size() && (1L << level) < span) {
+        level++;
+    }
+    return level;
+}
+
+HeightRange HeightPyramid::range(const HeightGrid& heights, long firstRow, long firstColumn, long lastRow,
+                                 long lastColumn) const {
+    firstRow = std::clamp(firstRow, 0L, nSquareRows - 1);
+    lastRow = std::clamp(lastRow, firstRow, nSquareRows - 1);
+    firstColumn = std::clamp(firstColumn, 0L, nSquareColumns - 1);
+    lastColumn = std::clamp(lastColumn, firstColumn, nSquareColumns - 1);
+
+    const size_t level = levelSpanning(firstRow, firstColumn, lastRow, lastColumn);
+    if (level == 0) {
+        // at most 2 x 2 squares, so read their 3 x 3 corners once each rather than 4 per square
+        HeightRange result{heights(firstRow, firstColumn), heights(firstRow, firstColumn)};
+        for (long row = firstRow; row <= lastRow + 1; row++) {
+            for (long column = firstColumn; column <= lastColumn + 1; column++) {
+                const float height = heights(row, column);
+                result.minimum = std::min(result.minimum, height);
+                result.maximum = std::max(result.maximum, height);
+            }
+        }
+        return result;
+    }
+    HeightRange result = entry(heights, level, firstRow >> level, firstColumn >> level);
+    for (long row = firstRow >> level; row <= lastRow >> level; row++) {
+        for (long column = firstColumn >> level; column <= lastColumn >> level; column++) {
+            const HeightRange block = entry(heights, level, row, column);
+            result.minimum = std::min(result.minimum, block.minimum);
+            result.maximum = std::max(result.maximum, block.maximum);
+        }
+    }
+    return result;
+}
+
+void HeightPyramid::findSquaresReaching(const HeightGrid& heights, long firstRow, long firstColumn, long lastRow,
+                                        long lastColumn, const float height, std::vector<long>& squares) const {
+    if (empty()) {
+        return;
+    }
+    firstRow = std::clamp(firstRow, 0L, nSquareRows - 1);
+    lastRow = std::clamp(lastRow, firstRow, nSquareRows - 1);
+    firstColumn = std::clamp(firstColumn, 0L, nSquareColumns - 1);
+    lastColumn = std::clamp(lastColumn, firstColumn, nSquareColumns - 1);
+
+    // start from the same few blocks range() reads, then refine
+    const size_t level = levelSpanning(firstRow, firstColumn, lastRow, lastColumn);
+    for (long row = firstRow >> level; row <= lastRow >> level; row++) {
+        for (long column = firstColumn >> level; column <= lastColumn >> level; column++) {
+            findInBlock(heights, level, row, column, firstRow, firstColumn, lastRow, lastColumn, height, squares);
+        }
+    }
+}
+
+void HeightPyramid::findInBlock(const HeightGrid& heights, const size_t level, const long row, const long column,
+                                const long firstRow, const long firstColumn, const long lastRow,
+                                const long lastColumn, const float height, std::vector<long>& squares) const {
+    if (entry(heights, level, row, column).maximum < height) {
+        return;
+    }
+    if (level == 0) {
+        squares.push_back(row * nSquareColumns + column);
+        return;
+    }
+
+    // children of this block that overlap the range
+    const long childRows = level == 1 ? nSquareRows : levels[level - 2].rows;
+    const long childColumns = level == 1 ? nSquareColumns : levels[level - 2].columns;
+    const long shift = level - 1;
+    const long firstChildRow = std::max(2 * row, firstRow >> shift);
+    const long lastChildRow = std::min({2 * row + 1, lastRow >> shift, childRows - 1});
+    const long firstChildColumn = std::max(2 * column, firstColumn >> shift);
+    const long lastChildColumn = std::min({2 * column + 1, lastColumn >> shift, childColumns - 1});
+    for (long childRow = firstChildRow; childRow <= lastChildRow; childRow++) {
+        for (long childColumn = firstChildColumn; childColumn <= lastChildColumn; childColumn++) {
+            findInBlock(heights, level - 1, childRow, childColumn, firstRow, firstColumn, lastRow, lastColumn,
+                        height, squares);
+        }
+    }
+}
@@ -1,80 +1,208 @@
 #include "IndexedFaceSurface.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <cmath>
 #include <cstring>
+#include <string>
 
-#ifdef _WIN32
-#include <windows.h>
-#endif
-#ifdef __APPLE__
-#include <OpenGL/gl.h>
-#include <OpenGL/glu.h>
-#else
-#include <GL/gl.h>
-#endif
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include "TextParsing.h"
 
-constexpr int LINE_SIZE_LIMIT = 256;
+constexpr std::uint32_t surfaceFileVersion = 1;
 
-IndexedFaceSurface::IndexedFaceSurface() {
+IndexedFaceSurface::IndexedFaceSurface()
+    : boundingSphereRadius(0.0f) {
     vertices.resize(0);
     normals.resize(0);
 }
 
 bool IndexedFaceSurface::readIndexedFaceFile(const char* fileName) {
-    std::ifstream inFile(fileName);
-    if (inFile.bad()) {
-        return false;
+    if (hasFileExtension(fileName, ".faceb")) {
+        return readBinaryIndexedFaceFile(fileName);
     }
 
-    char lineBuffer[LINE_SIZE_LIMIT];
-    char token[LINE_SIZE_LIMIT];
-
-    long nTriangles = 0, nVertices = 0;
+    MappedFile file;
+    if (!file.open(fileName)) {
+        reportParseError(fileName, 0, "unable to open file");
+        return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(file.data());
+    const char* end = begin + file.size();
 
     // read the only header line we care about
-    inFile.getline(lineBuffer, LINE_SIZE_LIMIT);
-    sscanf(lineBuffer, "# Surface vertices=%ld faces=%ld", &nVertices, &nTriangles);
+    TextCursor cursor(begin, end, 1);
+    long nTriangles = 0, nVertices = 0;
+    if (!cursor.expectText("#") || !cursor.expectText("Surface") ||
+        !cursor.expectText("vertices=") || !cursor.readLong(nVertices) ||
+        !cursor.expectText("faces=") || !cursor.readLong(nTriangles) ||
+        cursor.line != 1 || nVertices < 0 || nTriangles < 0) {
+        reportParseError(fileName, 1, "expected \"# Surface vertices=<n> faces=<n>\"");
+        return false;
+    }
+    cursor.skipLine();
 
     // skip next line
-    inFile.getline(lineBuffer, LINE_SIZE_LIMIT);
+    cursor.skipLine();
 
-    // allocate space for them all
-    vertices.resize(nVertices);
-    faceVertices.resize(nTriangles * 3);
+    // one record per non-blank line: first the vertices, then the faces
+    const size_t nRecords = nVertices + nTriangles;
+    std::vector<const char*> recordStarts;
+    std::vector<long> recordLines;
+    recordStarts.reserve(nRecords);
+    recordLines.reserve(nRecords);
+    while (recordStarts.size() < nRecords && !cursor.atEnd()) {
+        recordStarts.push_back(cursor.position);
+        recordLines.push_back(cursor.line);
+        cursor.skipLine();
+    }
+    if (recordStarts.size() < nRecords) {
+        reportParseError(fileName, cursor.line, "file ends after " + std::to_string(recordStarts.size()) + " of " +
+                                                std::to_string(nRecords) + " vertex and face lines");
+        return false;
+    }
 
-    // loop to read the vertices in
-    for (size_t vertex = 0; vertex < nVertices; vertex++) {
-        long vertexID;
-        inFile >> token >> vertexID;
+    // allocate space for them all, apart from the current surface, which is kept until the whole file has parsed
+    std::vector<Cartesian3> newVertices(nVertices);
+    std::vector<int> newFaceVertices(nTriangles * 3);
 
-        if (strcmp(token, "Vertex") != 0 || vertexID != vertex) {
-            printf("Invalid vertex %ld\n", vertex);
-            exit(0);
+    // parse ranges of records in parallel, each remembering its first error
+    const char* recordsBegin = recordStarts.empty() ? end : recordStarts.front();
+    const size_t nParts = std::min(nRecords, textPartCount(end - recordsBegin));
+    std::vector<std::string> partErrors(nParts);
+    std::vector<long> partErrorLines(nParts, 0);
+    forEachTextPart(end - recordsBegin, nParts, [&](const size_t part) {
+        const size_t firstRecord = nRecords * part / nParts;
+        const size_t lastRecord = nRecords * (part + 1) / nParts;
+        for (size_t record = firstRecord; record < lastRecord; record++) {
+            TextCursor lineCursor(recordStarts[record], end, recordLines[record]);
+            const bool isVertex = record < static_cast<size_t>(nVertices);
+            const long id = isVertex ? record : record - nVertices;
+
+            long recordID = -1;
+            bool isValid = lineCursor.expectWord(isVertex ? "Vertex" : "Face") &&
+                           lineCursor.readLong(recordID) && recordID == id;
+            if (isValid && isVertex) {
+                Cartesian3& vertex = newVertices[id];
+                isValid = lineCursor.readFloat(vertex.x) && lineCursor.readFloat(vertex.y) &&
+                          lineCursor.readFloat(vertex.z);
+            } else if (isValid) {
+                for (int corner = 0; corner < 3 && isValid; corner++) {
+                    int& vertex = newFaceVertices[3 * id + corner];
+                    isValid = lineCursor.readInt(vertex) && vertex >= 0 && vertex < nVertices;
+                }
+            }
+            lineCursor.skipBlanks();
+            isValid = isValid && (lineCursor.position == end || *lineCursor.position == '\n');
+
+            if (!isValid) {
+                partErrorLines[part] = recordLines[record];
+                partErrors[part] = isVertex
+                                       ? "expected \"Vertex " + std::to_string(id) + " <x> <y> <z>\""
+                                       : "expected \"Face " + std::to_string(id) +
+                                         " <v0> <v1> <v2>\" with vertex indices below " +
+                                         std::to_string(nVertices);
+                return;
+            }
         }
+    });
 
-        inFile >> vertices[vertex].x >> vertices[vertex].y >> vertices[vertex].z;
+    // report the first error in file order
+    for (size_t part = 0; part < nParts; part++) {
+        if (!partErrors[part].empty()) {
+            reportParseError(fileName, partErrorLines[part], partErrors[part]);
+            return false;
+        }
     }
 
-    // loop to read the faceVertices in
-    for (size_t face = 0; face < faceVertices.size() / 3; face++) {
-        long faceID;
-        inFile >> token >> faceID;
+    vertices = std::move(newVertices);
+    faceVertices = std::move(newFaceVertices);
+    computeDerivedData();
 
-        if (strcmp("Face", token) != 0 || faceID != face) {
-            printf("Invalid face %ld\n", face);
-            exit(0);
-        }
+    return true;
+}
 
-        inFile >> faceVertices[3 * face] >> faceVertices[3 * face + 1] >> faceVertices[3 * face + 2];
+bool IndexedFaceSurface::readBinaryIndexedFaceFile(const char* fileName) {
+    MappedFile file;
+    if (!file.open(fileName) || file.size() < sizeof(SurfaceFileHeader)) {
+        return false;
     }
 
-    computeUnitNormalVectors();
+    SurfaceFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "FACB", 4) != 0 || header.version != surfaceFileVersion) {
+        return false;
+    }
+
+    const std::uint64_t verticesSize = static_cast<std::uint64_t>(header.vertexCount) * sizeof(Cartesian3);
+    const std::uint64_t facesSize = static_cast<std::uint64_t>(header.faceCount) * 3 * sizeof(int);
+    const std::uint64_t normalsSize = static_cast<std::uint64_t>(header.faceCount) * sizeof(Cartesian3);
+    if (header.verticesOffset + verticesSize > file.size() ||
+        header.facesOffset + facesSize > file.size() ||
+        header.normalsOffset + normalsSize > file.size()) {
+        return false;
+    }
+
+    // reject faces pointing outside the vertex array before anything is replaced
+    std::vector<int> newFaceVertices(header.faceCount * 3);
+    std::memcpy(newFaceVertices.data(), file.data() + header.facesOffset, facesSize);
+    for (const int vertex : newFaceVertices) {
+        if (vertex < 0 || vertex >= static_cast<int>(header.vertexCount)) {
+            return false;
+        }
+    }
+
+    // bulk copies out of the mapping, nothing is parsed or recomputed
+    faceVertices = std::move(newFaceVertices);
+    vertices.resize(header.vertexCount);
+    normals.resize(header.faceCount);
+    std::memcpy(vertices.data(), file.data() + header.verticesOffset, verticesSize);
+    std::memcpy(normals.data(), file.data() + header.normalsOffset, normalsSize);
+
+    boundingSphereCentre = Cartesian3(header.boundingSphereCentre[0], header.boundingSphereCentre[1],
+                                      header.boundingSphereCentre[2]);
+    boundingSphereRadius = header.boundingSphereRadius;
+    std::memcpy(inertia.coordinates, header.inertia, sizeof(header.inertia));
 
     return true;
 }
 
+bool IndexedFaceSurface::writeBinaryIndexedFaceFile(const char* fileName) const {
+    std::ofstream outFile(fileName, std::ios::binary);
+    if (!outFile) {
+        return false;
+    }
+
+    SurfaceFileHeader header{};
+    std::memcpy(header.magic, "FACB", 4);
+    header.version = surfaceFileVersion;
+    header.vertexCount = vertices.size();
+    header.faceCount = faceVertices.size() / 3;
+    header.boundingSphereCentre[0] = boundingSphereCentre.x;
+    header.boundingSphereCentre[1] = boundingSphereCentre.y;
+    header.boundingSphereCentre[2] = boundingSphereCentre.z;
+    header.boundingSphereRadius = boundingSphereRadius;
+    std::memcpy(header.inertia, inertia.coordinates, sizeof(header.inertia));
+
+    const std::uint64_t verticesSize = vertices.size() * sizeof(Cartesian3);
+    const std::uint64_t facesSize = faceVertices.size() * sizeof(int);
+    header.verticesOffset = alignFileOffset(sizeof(header));
+    header.facesOffset = alignFileOffset(header.verticesOffset + verticesSize);
+    header.normalsOffset = alignFileOffset(header.facesOffset + facesSize);
+
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    padToFileOffset(outFile, header.verticesOffset);
+    outFile.write(reinterpret_cast<const char*>(vertices.data()), verticesSize);
+    padToFileOffset(outFile, header.facesOffset);
+    outFile.write(reinterpret_cast<const char*>(faceVertices.data()), facesSize);
+    padToFileOffset(outFile, header.normalsOffset);
+    outFile.write(reinterpret_cast<const char*>(normals.data()), normals.size() * sizeof(Cartesian3));
+
+    return static_cast<bool>(outFile);
+}
+
 void IndexedFaceSurface::computeUnitNormalVectors() {
     // Each 3-indexed faces has 1 normal
     normals.resize(faceVertices.size() / 3);
@@ -92,18 +220,27 @@ void IndexedFaceSurface::computeUnitNormalVectors() {
     }
 }
 
-void IndexedFaceSurface::render() const {
-    // Render all triangles
-    glBegin(GL_TRIANGLES);
+void IndexedFaceSurface::computeDerivedData() {
+    computeUnitNormalVectors();
 
-    for (size_t triangle = 0; triangle < normals.size(); triangle++) {
-        glNormal3fv(&normals[triangle].x);
-        glVertex3fv(&vertices[faceVertices[3 * triangle]].x);
-        glVertex3fv(&vertices[faceVertices[3 * triangle + 1]].x);
-        glVertex3fv(&vertices[faceVertices[3 * triangle + 2]].x);
+    // bounding sphere around the centre of the axis-aligned bounding box
+    Cartesian3 minimum, maximum;
+    if (!vertices.empty()) {
+        minimum = maximum = vertices[0];
+    }
+    for (const auto& vertex : vertices) {
+        for (int axis = 0; axis < 3; axis++) {
+            minimum[axis] = std::min(minimum[axis], vertex[axis]);
+            maximum[axis] = std::max(maximum[axis], vertex[axis]);
+        }
+    }
+    boundingSphereCentre = (minimum + maximum) * 0.5f;
+    boundingSphereRadius = 0.0f;
+    for (const auto& vertex : vertices) {
+        boundingSphereRadius = std::max(boundingSphereRadius, (vertex - boundingSphereCentre).length());
     }
 
-    glEnd();
+    inertia = inertialTensor();
 }
 
 Matrix3 IndexedFaceSurface::inertialTensor() const {
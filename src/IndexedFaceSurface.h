@@ -1,11 +1,31 @@
 #ifndef INDEXED_FACE_SURFACE_H
 #define INDEXED_FACE_SURFACE_H
 
+#include <cstdint>
 #include <vector>
 
 #include "Cartesian3.h"
 #include "Matrix3.h"
 
+// Header of the binary .faceb surface format, little endian.
+// Each block starts at a 64-byte aligned offset: vertexCount vertices (3 float32 each),
+// faceCount faces (3 int32 vertex indices each) and faceCount unit normals (3 float32 each).
+// The bounding sphere and inertial tensor are stored precomputed.
+struct SurfaceFileHeader {
+    // "FACB"
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t vertexCount;
+    std::uint32_t faceCount;
+    float boundingSphereCentre[3];
+    float boundingSphereRadius;
+    // row-major, see IndexedFaceSurface::inertialTensor
+    float inertia[3][3];
+    std::uint64_t verticesOffset;
+    std::uint64_t facesOffset;
+    std::uint64_t normalsOffset;
+};
+
 class IndexedFaceSurface {
 public:
     // vector to hold the vertex indices for each face in CCW
@@ -13,13 +33,28 @@ public:
     std::vector<Cartesian3> vertices;
     std::vector<Cartesian3> normals;
 
+    // derived data, kept up to date by computeDerivedData()
+    Cartesian3 boundingSphereCentre;
+    float boundingSphereRadius;
+    // inertialTensor(), cached
+    Matrix3 inertia;
+
     IndexedFaceSurface();
 
+    // reads a .face surface, or .faceb if the file name ends that way;
+    // the surface is left as it was if the file does not load
     bool readIndexedFaceFile(const char* fileName);
 
+    // reads a binary .faceb surface, mapping it instead of parsing it
+    bool readBinaryIndexedFaceFile(const char* fileName);
+
+    // writes the surface and its derived data as .faceb
+    bool writeBinaryIndexedFaceFile(const char* fileName) const;
+
     void computeUnitNormalVectors();
 
-    void render() const;
+    // recompute normals, bounding sphere and inertia after the vertices or faces change
+    void computeDerivedData();
 
     // return the inertial tensor, assuming all vertices are equal weight
     Matrix3 inertialTensor() const;
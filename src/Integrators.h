@@ -0,0 +1,118 @@
+#ifndef INTEGRATORS_H
+#define INTEGRATORS_H
+
+#include <cmath>
+
+#include "Cartesian3.h"
+#include "Quaternion.h"
+
+// Integration schemes for the ball's motion between bounce impulses, used as compile-time policies
+// so the stepping loops contain no integrator branches. Every step is split the same way, so
+// collisions can change the velocity part way through it:
+//   velocity = kick(velocity, acceleration, dt)              velocity gained over the whole step
+//   ... bounce impulses ...
+//   position = drift(position, velocity, acceleration, dt)   given the velocity at the end of the step
+//   orientation = rotate(orientation, angularVelocity, dt)
+// kick and drift take a Cartesian3 with a float dt, or one coordinate of SimdFloat::width balls
+// with a SimdFloat dt.
+//
+// Gravity is the only force between impulses, so Verlet and RK4 translation are both exact and
+// differ only in rounding, while semi-implicit Euler is off by half a step of gravity per step.
+// The angular velocity is in world space and constant between impulses, and the orientation follows
+// d(orientation)/dt = 0.5 * angularVelocity * orientation.
+
+// which policy to instantiate, for choosing one at run time
+enum class Integrator {
+    SemiImplicitEuler,
+    VelocityVerlet,
+    RungeKutta4
+};
+
+// short lower case name of an integrator, for reports and command lines
+inline const char* integratorName(const Integrator integrator) {
+    switch (integrator) {
+        case Integrator::VelocityVerlet:
+            return "verlet";
+        case Integrator::RungeKutta4:
+            return "rk4";
+        default:
+            return "euler";
+    }
+}
+
+// quaternion scaled back to unit length, as polynomial steps let it drift
+inline Quaternion normalised(const Quaternion& quat) {
+    return quat / std::sqrt(quat.norm());
+}
+
+// First order: position moves with the velocity at the end of the step.
+// The orientation turns by the exponential map of the new angular velocity, which is the
+// semi-implicit Euler step on the rotation group
+struct SemiImplicitEuler {
+    template <typename Value, typename Scalar>
+    static Value kick(const Value& velocity, const Value& acceleration, const Scalar& dt) {
+        return velocity + acceleration * dt;
+    }
+
+    template <typename Value, typename Scalar>
+    static Value drift(const Value& position, const Value& velocity, const Value&, const Scalar& dt) {
+        return position + velocity * dt;
+    }
+
+    static Quaternion rotate(const Quaternion& orientation, const Cartesian3& angularVelocity, const float dt) {
+        // avoiding ||w|| = 0 edge case
+        const float speed = angularVelocity.length();
+        if (speed <= 0.0f) {
+            return orientation;
+        }
+        // Quaternion(axis, theta) turns by 2 theta
+        return Quaternion(angularVelocity.unit(), 0.5f * speed * dt) * orientation;
+    }
+};
+
+// Second order: position moves with the mean velocity over the step, and the orientation with
+// its second order Taylor expansion
+struct VelocityVerlet {
+    template <typename Value, typename Scalar>
+    static Value kick(const Value& velocity, const Value& acceleration, const Scalar& dt) {
+        return velocity + acceleration * dt;
+    }
+
+    template <typename Value, typename Scalar>
+    static Value drift(const Value& position, const Value& velocity, const Value& acceleration, const Scalar& dt) {
+        return position + (velocity - acceleration * (dt * Scalar(0.5f))) * dt;
+    }
+
+    static Quaternion rotate(const Quaternion& orientation, const Cartesian3& angularVelocity, const float dt) {
+        const Quaternion spin = Quaternion(angularVelocity) * 0.5f;
+        const Quaternion rate = spin * orientation;
+        return normalised(orientation + rate * dt + spin * rate * (0.5f * dt * dt));
+    }
+};
+
+// Fourth order Runge-Kutta for both position and orientation
+struct RungeKutta4 {
+    template <typename Value, typename Scalar>
+    static Value kick(const Value& velocity, const Value& acceleration, const Scalar& dt) {
+        return velocity + acceleration * dt;
+    }
+
+    template <typename Value, typename Scalar>
+    static Value drift(const Value& position, const Value& velocity, const Value& acceleration, const Scalar& dt) {
+        // the position's slope at the start, middle (twice) and end of the step
+        const Value start = velocity - acceleration * dt;
+        const Value middle = start + acceleration * (dt * Scalar(0.5f));
+        return position + (start + middle * Scalar(4.0f) + velocity) * (dt * Scalar(1.0f / 6.0f));
+    }
+
+    static Quaternion rotate(const Quaternion& orientation, const Cartesian3& angularVelocity, const float dt) {
+        const Quaternion spin = Quaternion(angularVelocity) * 0.5f;
+        const Quaternion k1 = spin * orientation;
+        const Quaternion k2 = spin * (orientation + k1 * (0.5f * dt));
+        const Quaternion k3 = spin * (orientation + k2 * (0.5f * dt));
+        const Quaternion k4 = spin * (orientation + k3 * dt);
+        return normalised(orientation + (k1 + k2 * 2.0f + k3 * 2.0f + k4) * (dt / 6.0f));
+    }
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "LaunchSweep.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+constexpr std::uint32_t sweepRasterVersion = 2;
+
+// landing x, y, final x, y, z, outcome and bounce count
+constexpr std::uint32_t sweepRasterChannels = 7;
+
+SweepAxis::SweepAxis()
+    : minimum(0.0f),
+      maximum(0.0f),
+      count(1) {
+}
+
+SweepAxis::SweepAxis(const float minimum, const float maximum, const unsigned count)
+    : minimum(minimum),
+      maximum(maximum),
+      count(count) {
+}
+
+float SweepAxis::value(const unsigned step) const {
+    if (count < 2) {
+        return minimum;
+    }
+    return minimum + (maximum - minimum) * step / (count - 1);
+}
+
+LaunchSweep::LaunchSweep()
+    : angles(0.0f, 355.0f, 72),
+      speeds(5.0f, 5.0f, 1),
+      heights(10.0f, 10.0f, 1),
+      terrain(nullptr),
+      ballModel(nullptr),
+      useSphere(true),
+      continuousCollision(false),
+      eventDriven(false),
+      integrator(Integrator::SemiImplicitEuler),
+      frameTime(0.0166667f),
+      duration(30.0f),
+      restSpeedThreshold(0.2f),
+      tileSize(16) {
+}
+
+size_t LaunchSweep::launchCount() const {
+    return static_cast<size_t>(angles.count) * speeds.count * heights.count;
+}
+
+size_t LaunchSweep::resultIndex(const unsigned angle, const unsigned speed, const unsigned height) const {
+    return (static_cast<size_t>(height) * speeds.count + speed) * angles.count + angle;
+}
+
+void LaunchSweep::run(WorkStealingExecutor& executor) {
+    results.assign(launchCount(), SweepResult());
+
+    // a tile is a run of consecutive angles at one speed and height
+    const unsigned launchesPerTile = std::max(1u, tileSize);
+    const unsigned tilesPerRow = (angles.count + launchesPerTile - 1) / launchesPerTile;
+    const size_t tileCount = static_cast<size_t>(tilesPerRow) * speeds.count * heights.count;
+    const unsigned long maxFrames = static_cast<unsigned long>(duration / frameTime);
+
+    // per worker scratch: one simulation per launch of a tile
+    std::vector<std::vector<Simulation>> workerSimulations(executor.threadCount(),
+                                                           std::vector<Simulation>(launchesPerTile));
+    for (auto& simulations : workerSimulations) {
+        for (auto& simulation : simulations) {
+            simulation.terrain = terrain;
+            simulation.ballModel = ballModel;
+            simulation.useSphere = useSphere;
+            simulation.continuousCollision = continuousCollision;
+            simulation.eventDriven = eventDriven;
+            simulation.integrator = integrator;
+            simulation.frameTime = frameTime;
+        }
+    }
+
+    executor.parallelFor(tileCount, [&](const size_t tile, const unsigned worker) {
+        const unsigned row = tile / tilesPerRow;
+        const unsigned speed = row % speeds.count;
+        const unsigned height = row / speeds.count;
+        const unsigned firstAngle = (tile % tilesPerRow) * launchesPerTile;
+        const unsigned tileLaunches = std::min(launchesPerTile, angles.count - firstAngle);
+
+        std::vector<Simulation>& simulations = workerSimulations[worker];
+        std::vector<bool> isRunning(tileLaunches, true);
+        std::vector<SimulationOutcome> outcomes(tileLaunches, SimulationOutcome::Running);
+        for (unsigned launch = 0; launch < tileLaunches; launch++) {
+            Simulation& simulation = simulations[launch];
+            simulation.launchAngle = angles.value(firstAngle + launch);
+            simulation.launchPosition = Cartesian3(0.0f, 0.0f, heights.value(height));
+            simulation.launchVelocity = Cartesian3(speeds.value(speed), 0.0f, 0.0f);
+            simulation.reset();
+        }
+
+        // lockstep: advance every launch of the tile by one frame before moving on.
+        // Event-driven launches jump over whole flights, which single frames would cut short,
+        // so each of them runs on to its end in one go instead
+        const unsigned long lockstepFrames = useSphere && eventDriven ? maxFrames : 1;
+        unsigned running = tileLaunches;
+        for (unsigned long frame = 0; frame < maxFrames && running > 0; frame += lockstepFrames) {
+            for (unsigned launch = 0; launch < tileLaunches; launch++) {
+                if (!isRunning[launch]) {
+                    continue;
+                }
+                const unsigned long frames = std::min(lockstepFrames, maxFrames - frame);
+                const SimulationOutcome outcome = simulations[launch].run(frames, restSpeedThreshold);
+                if (outcome != SimulationOutcome::Running) {
+                    outcomes[launch] = outcome;
+                    isRunning[launch] = false;
+                    running--;
+                }
+            }
+        }
+
+        for (unsigned launch = 0; launch < tileLaunches; launch++) {
+            const Simulation& simulation = simulations[launch];
+            results[resultIndex(firstAngle + launch, speed, height)] = SweepResult{
+                simulation.landingPosition,
+                simulation.landingTime,
+                simulation.bounceCount,
+                simulation.ballPosition,
+                simulation.elapsedTime,
+                outcomes[launch]
+            };
+        }
+    });
+}
+
+bool LaunchSweep::writeRaster(const char* fileName) const {
+    std::ofstream outFile(fileName, std::ios::binary);
+    if (!outFile) {
+        return false;
+    }
+
+    SweepRasterHeader header{};
+    std::memcpy(header.magic, "BISR", 4);
+    header.version = sweepRasterVersion;
+    header.angleCount = angles.count;
+    header.speedCount = speeds.count;
+    header.heightCount = heights.count;
+    header.channelCount = sweepRasterChannels;
+    header.angleMinimum = angles.minimum;
+    header.angleMaximum = angles.maximum;
+    header.speedMinimum = speeds.minimum;
+    header.speedMaximum = speeds.maximum;
+    header.heightMinimum = heights.minimum;
+    header.heightMaximum = heights.maximum;
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<float> cells;
+    cells.reserve(results.size() * sweepRasterChannels);
+    for (const auto& result : results) {
+        // a ball that never landed has no landing point, rather than one at the origin
+        const bool hasLanded = result.bounceCount > 0;
+        const float noLanding = std::numeric_limits<float>::quiet_NaN();
+        cells.push_back(hasLanded ? result.landingPosition.x : noLanding);
+        cells.push_back(hasLanded ? result.landingPosition.y : noLanding);
+        cells.push_back(result.finalPosition.x);
+        cells.push_back(result.finalPosition.y);
+        cells.push_back(result.finalPosition.z);
+        cells.push_back(static_cast<float>(result.outcome));
+        cells.push_back(static_cast<float>(result.bounceCount));
+    }
+    outFile.write(reinterpret_cast<const char*>(cells.data()), cells.size() * sizeof(float));
+
+    return static_cast<bool>(outFile);
+}
+
+void LaunchSweep::writeSummary(std::ostream& out) const {
+    out << "angle,speed,height,landingX,landingY,landingZ,landingTime,bounces,finalX,finalY,finalZ,time,outcome\n";
+    for (unsigned height = 0; height < heights.count; height++) {
+        for (unsigned speed = 0; speed < speeds.count; speed++) {
+            for (unsigned angle = 0; angle < angles.count; angle++) {
+                const SweepResult& result = results[resultIndex(angle, speed, height)];
+                out << angles.value(angle) << ',' << speeds.value(speed) << ',' << heights.value(height) << ','
+                    << result.landingPosition.x << ',' << result.landingPosition.y << ','
+                    << result.landingPosition.z << ',' << result.landingTime << ','
+                    << result.bounceCount << ','
+                    << result.finalPosition.x << ',' << result.finalPosition.y << ','
+                    << result.finalPosition.z << ',' << result.elapsedTime << ','
+                    << simulationOutcomeName(result.outcome) << '\n';
+            }
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef LAUNCH_SWEEP_H
+#define LAUNCH_SWEEP_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "HeightField.h"
+#include "IndexedFaceSurface.h"
+#include "Simulation.h"
+#include "WorkStealingExecutor.h"
+
+// count evenly spaced values from minimum to maximum, both included
+class SweepAxis {
+public:
+    float minimum;
+    float maximum;
+    unsigned count;
+
+    SweepAxis();
+
+    SweepAxis(float minimum, float maximum, unsigned count);
+
+    float value(unsigned step) const;
+};
+
+// what one launch of the sweep produced
+struct SweepResult {
+    Cartesian3 landingPosition;
+    float landingTime;
+    unsigned long bounceCount;
+    Cartesian3 finalPosition;
+    float elapsedTime;
+    SimulationOutcome outcome;
+};
+
+// Grid of launch angles x launch speeds x launch heights on one terrain.
+// Neighbouring angles are stepped in lockstep, tileSize at a time, so they touch the same
+// part of the terrain at the same time and keep it hot in cache. Event-driven launches skip
+// their flights instead, one launch after another.
+class LaunchSweep {
+public:
+    SweepAxis angles;
+    SweepAxis speeds;
+    SweepAxis heights;
+
+    // shared read-only by every worker
+    const HeightField* terrain;
+    const IndexedFaceSurface* ballModel;
+    bool useSphere;
+    // see Simulation::continuousCollision
+    bool continuousCollision;
+    // see Simulation::eventDriven
+    bool eventDriven;
+    // see Simulation::integrator
+    Integrator integrator;
+
+    float frameTime;
+    // maximum simulated time per launch
+    float duration;
+    float restSpeedThreshold;
+
+    // launches of consecutive angles simulated together by one worker
+    unsigned tileSize;
+
+    // one entry per launch, indexed by resultIndex()
+    std::vector<SweepResult> results;
+
+    LaunchSweep();
+
+    size_t launchCount() const;
+
+    // results are laid out [height][speed][angle], angle varying fastest
+    size_t resultIndex(unsigned angle, unsigned speed, unsigned height) const;
+
+    // simulate every launch of the grid
+    void run(WorkStealingExecutor& executor);
+
+    // Binary raster: a SweepRasterHeader followed by float32 cells laid out like results,
+    // each cell holding landing x, y (NaN if the ball never landed), final x, y, z,
+    // the outcome (the SimulationOutcome's value) and the bounce count
+    bool writeRaster(const char* fileName) const;
+
+    // one CSV row per launch
+    void writeSummary(std::ostream& out) const;
+};
+
+// header of the binary raster written by LaunchSweep::writeRaster, little endian
+struct SweepRasterHeader {
+    // "BISR"
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t angleCount;
+    std::uint32_t speedCount;
+    std::uint32_t heightCount;
+    // floats per cell
+    std::uint32_t channelCount;
+    float angleMinimum, angleMaximum;
+    float speedMinimum, speedMaximum;
+    float heightMinimum, heightMaximum;
+};
+
+#endif
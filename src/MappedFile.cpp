@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mapping(nullptr),
+      length(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char* fileName) {
+    close();
+
+#ifdef _WIN32
+    std::ifstream inFile(fileName, std::ios::binary | std::ios::ate);
+    if (!inFile) {
+        return false;
+    }
+    buffer.resize(inFile.tellg());
+    inFile.seekg(0);
+    if (!inFile.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+        buffer.clear();
+        return false;
+    }
+    mapping = buffer.data();
+    length = buffer.size();
+    return true;
+#else
+    const int descriptor = ::open(fileName, O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+        ::close(descriptor);
+        return false;
+    }
+
+    void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    // the mapping keeps the file alive on its own
+    ::close(descriptor);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    mapping = static_cast<const unsigned char*>(address);
+    length = status.st_size;
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (mapping != nullptr) {
+        munmap(const_cast<unsigned char*>(mapping), length);
+    }
+#endif
+    buffer.clear();
+    mapping = nullptr;
+    length = 0;
+}
+
+const unsigned char* MappedFile::data() const {
+    return mapping;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+#ifndef _WIN32
+// madvise on the whole pages covering the range
+static void advise(const unsigned char* mapping, const size_t length, size_t offset, size_t size, const int advice) {
+    if (mapping == nullptr || offset >= length) {
+        return;
+    }
+    size = std::min(size, length - offset);
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t first = offset / pageSize * pageSize;
+    madvise(const_cast<unsigned char*>(mapping) + first, offset + size - first, advice);
+}
+#endif
+
+void MappedFile::prefetch(const size_t offset, const size_t size) const {
+#ifndef _WIN32
+    advise(mapping, length, offset, size, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::release(const size_t offset, const size_t size) const {
+#ifndef _WIN32
+    advise(mapping, length, offset, size, MADV_DONTNEED);
+#endif
+}
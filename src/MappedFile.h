@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <vector>
+
+// Read-only view of a whole file, memory mapped where the platform allows it
+// (POSIX mmap), otherwise read into memory. Unmapped on destruction.
+class MappedFile {
+public:
+    MappedFile();
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator =(const MappedFile&) = delete;
+
+    // map fileName, replacing any previous mapping; false if it cannot be opened
+    bool open(const char* fileName);
+
+    void close();
+
+    const unsigned char* data() const;
+
+    size_t size() const;
+
+    // Paging hints for size bytes from offset, widened to whole pages; they do nothing without mmap.
+    // prefetch starts reading the range in the background, release drops its pages from memory,
+    // to be read from the file again if they are touched
+    void prefetch(size_t offset, size_t size) const;
+    void release(size_t offset, size_t size) const;
+
+private:
+    const unsigned char* mapping;
+    size_t length;
+
+    // used instead of a mapping on platforms without mmap
+    std::vector<unsigned char> buffer;
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "PagedTerrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "BinaryIO.h"
+
+constexpr std::uint32_t tiledTerrainFileVersion = 2;
+
+// tiles start on page boundaries, so releasing one never drops part of its neighbour
+constexpr std::uint64_t tilePageSize = 4096;
+
+static std::uint64_t alignToPage(const std::uint64_t offset) {
+    return (offset + tilePageSize - 1) / tilePageSize * tilePageSize;
+}
+
+bool writeTiledTerrainFile(const char* fileName, const long rows, const long columns, const long tileSize,
+                           const std::function<void(long row, long column, long count, float* values)>& readHeights) {
+    if (rows < 2 || columns < 2 || tileSize < 1) {
+        return false;
+    }
+
+    std::ofstream outFile(fileName, std::ios::binary);
+    if (!outFile) {
+        return false;
+    }
+
+    TiledTerrainFileHeader header{};
+    std::memcpy(header.magic, "DEMT", 4);
+    header.version = tiledTerrainFileVersion;
+    header.rows = rows;
+    header.columns = columns;
+    header.tileSize = tileSize;
+    header.tileRows = (rows - 2) / tileSize + 1;
+    header.tileColumns = (columns - 2) / tileSize + 1;
+    const long tileWidth = tileSize + 1;
+    header.tileStride = alignToPage(static_cast<std::uint64_t>(tileWidth) * tileWidth * sizeof(float));
+    header.tilesOffset = alignToPage(sizeof(header));
+    const std::uint64_t nTiles = static_cast<std::uint64_t>(header.tileRows) * header.tileColumns;
+    header.boundsOffset = header.tilesOffset + nTiles * header.tileStride;
+
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    padToFileOffset(outFile, header.tilesOffset);
+    // a whole stride at a time, the padding after the heights staying zero
+    std::vector<float> tileValues(header.tileStride / sizeof(float), 0.0f);
+    std::vector<float> tileHighest;
+    tileHighest.reserve(nTiles);
+    for (long tileRow = 0; tileRow < static_cast<long>(header.tileRows); tileRow++) {
+        for (long tileColumn = 0; tileColumn < static_cast<long>(header.tileColumns); tileColumn++) {
+            const long firstColumn = tileColumn * tileSize;
+            const long count = std::min(tileWidth, columns - firstColumn);
+            for (long localRow = 0; localRow < tileWidth; localRow++) {
+                // the last row and column of the grid repeat into the tiles' margins
+                float* values = tileValues.data() + localRow * tileWidth;
+                readHeights(std::min(tileRow * tileSize + localRow, rows - 1), firstColumn, count, values);
+                std::fill(values + count, values + tileWidth, values[count - 1]);
+            }
+            tileHighest.push_back(*std::max_element(tileValues.begin(), tileValues.begin() + tileWidth * tileWidth));
+            outFile.write(reinterpret_cast<const char*>(tileValues.data()), header.tileStride);
+        }
+    }
+    outFile.write(reinterpret_cast<const char*>(tileHighest.data()), tileHighest.size() * sizeof(float));
+
+    return static_cast<bool>(outFile);
+}
+
+PagedTerrain::PagedTerrain()
+    : xyScale(1),
+      nRows(0),
+      nColumns(0),
+      tileSize(0),
+      tileColumns(0),
+      tileStride(0),
+      tilesOffset(0),
+      tileCount(0),
+      maxResidentTiles(1),
+      clock(0) {
+}
+
+bool PagedTerrain::open(const char* fileName, const float xyScale, const size_t memoryBudget) {
+    if (!file.open(fileName)) {
+        return false;
+    }
+
+    TiledTerrainFileHeader header{};
+    if (file.size() < sizeof(header)) {
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    const std::uint64_t tileWidth = static_cast<std::uint64_t>(header.tileSize) + 1;
+    const std::uint64_t nTiles = static_cast<std::uint64_t>(header.tileRows) * header.tileColumns;
+    if (std::memcmp(header.magic, "DEMT", 4) != 0 || header.version != tiledTerrainFileVersion ||
+        header.rows < 2 || header.columns < 2 || header.tileSize < 1 ||
+        header.tileRows != (header.rows - 2) / header.tileSize + 1 ||
+        header.tileColumns != (header.columns - 2) / header.tileSize + 1 ||
+        header.tileStride < tileWidth * tileWidth * sizeof(float) || header.tileStride % tilePageSize != 0 ||
+        header.tilesOffset % tilePageSize != 0 ||
+        header.boundsOffset < header.tilesOffset + nTiles * header.tileStride ||
+        header.boundsOffset + nTiles * sizeof(float) > file.size()) {
+        file.close();
+        return false;
+    }
+
+    this->xyScale = xyScale;
+    nRows = header.rows;
+    nColumns = header.columns;
+    tileSize = header.tileSize;
+    tileColumns = header.tileColumns;
+    tileStride = header.tileStride;
+    tilesOffset = header.tilesOffset;
+    tileHighest.resize(nTiles);
+    std::memcpy(tileHighest.data(), file.data() + header.boundsOffset, nTiles * sizeof(float));
+
+    // nothing is resident until it is read
+    tileCount = nTiles;
+    tileStates = std::make_unique<TileState[]>(tileCount);
+    for (size_t tile = 0; tile < tileCount; tile++) {
+        tileStates[tile].lastUse.store(0, std::memory_order_relaxed);
+        tileStates[tile].isResident.store(false, std::memory_order_relaxed);
+    }
+    clock.store(0);
+    {
+        std::lock_guard<std::mutex> lock(residentMutex);
+        residentTiles.clear();
+    }
+    setMemoryBudget(memoryBudget);
+
+    return true;
+}
+
+void PagedTerrain::setMemoryBudget(const size_t memoryBudget) {
+    std::lock_guard<std::mutex> lock(residentMutex);
+    maxResidentTiles = std::max<size_t>(1, tileStride == 0 ? 1 : memoryBudget / tileStride);
+    releaseOldestTiles(maxResidentTiles);
+}
+
+size_t PagedTerrain::residentTileCount() const {
+    std::lock_guard<std::mutex> lock(residentMutex);
+    return residentTiles.size();
+}
+
+GridCell PagedTerrain::findCell(const float x, const float y) const {
+    return findGridCell(x, y, nRows, nColumns, xyScale);
+}
+
+size_t PagedTerrain::tileOf(const long row, const long column) const {
+    return static_cast<size_t>(row / tileSize) * tileColumns + column / tileSize;
+}
+
+const float* PagedTerrain::useTile(const size_t tile) const {
+    TileState& state = tileStates[tile];
+    if (!state.isResident.load(std::memory_order_relaxed) && !state.isResident.exchange(true)) {
+        admitTile(tile);
+    } else {
+        // only written when the clock has moved on, so threads reading the same tile rarely share a write
+        const std::uint64_t now = clock.load(std::memory_order_relaxed);
+        if (state.lastUse.load(std::memory_order_relaxed) != now) {
+            state.lastUse.store(now, std::memory_order_relaxed);
+        }
+    }
+    return reinterpret_cast<const float*>(file.data() + tilesOffset + tile * tileStride);
+}
+
+void PagedTerrain::admitTile(const size_t tile) const {
+    std::lock_guard<std::mutex> lock(residentMutex);
+    tileStates[tile].lastUse.store(clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    residentTiles.push_back(tile);
+    if (residentTiles.size() > maxResidentTiles) {
+        // release an eighth of the budget at once, so a stream of new tiles does not sort on every one
+        releaseOldestTiles(maxResidentTiles - maxResidentTiles / 8);
+    }
+}
+
+void PagedTerrain::releaseOldestTiles(const size_t keep) const {
+    if (residentTiles.size() <= keep) {
+        return;
+    }
+    const size_t releaseCount = residentTiles.size() - keep;
+    std::nth_element(residentTiles.begin(), residentTiles.begin() + releaseCount, residentTiles.end(),
+                     [this](const size_t first, const size_t second) {
+                         return tileStates[first].lastUse.load(std::memory_order_relaxed) <
+                                tileStates[second].lastUse.load(std::memory_order_relaxed);
+                     });
+    for (size_t index = 0; index < releaseCount; index++) {
+        const size_t tile = residentTiles[index];
+        tileStates[tile].isResident.store(false);
+        file.release(tilesOffset + tile * tileStride, tileStride);
+    }
+    residentTiles.erase(residentTiles.begin(), residentTiles.begin() + releaseCount);
+}
+
+HeightSquare PagedTerrain::cellSquare(const GridCell& cell) const {
+    const float* tileValues = useTile(tileOf(cell.row, cell.column));
+    const long tileWidth = tileSize + 1;
+    const float* topLeft = tileValues + (cell.row % tileSize) * tileWidth + cell.column % tileSize;
+    return HeightSquare{topLeft[0], topLeft[1], topLeft[tileWidth], topLeft[tileWidth + 1]};
+}
+
+Cartesian3 PagedTerrain::cellNormal(const GridCell& cell, const HeightSquare& corners) const {
+    // the corners as Terrain places its grid vertices
+    const float midPointX = xyScale * (nColumns / 2);
+    const float midPointY = xyScale * (nRows / 2);
+    const float left = xyScale * cell.column - midPointX;
+    const float right = xyScale * (cell.column + 1) - midPointX;
+    const float top = midPointY - xyScale * cell.row;
+    const float bottom = midPointY - xyScale * (cell.row + 1);
+    const Cartesian3 topLeft(left, top, corners.topLeft);
+
+    Cartesian3 second, third;
+    if (cell.xRemainder < cell.yRemainder) {
+        // LL triangle
+        second = Cartesian3(left, bottom, corners.bottomLeft);
+        third = Cartesian3(right, bottom, corners.bottomRight);
+    } else {
+        // UR triangle
+        second = Cartesian3(right, bottom, corners.bottomRight);
+        third = Cartesian3(right, top, corners.topRight);
+    }
+    return (second - topLeft).cross(third - topLeft).unit();
+}
+
+float PagedTerrain::getHeight(const float x, const float y) const {
+    const GridCell cell = findCell(x, y);
+    return squareHeight(cellSquare(cell), cell.xRemainder, cell.yRemainder);
+}
+
+Cartesian3 PagedTerrain::getNormal(const float x, const float y) const {
+    const GridCell cell = findCell(x, y);
+    return cellNormal(cell, cellSquare(cell));
+}
+
+void PagedTerrain::getHeightAndNormal(const float x, const float y, float& height, Cartesian3& normal) const {
+    const GridCell cell = findCell(x, y);
+    const HeightSquare corners = cellSquare(cell);
+    height = squareHeight(corners, cell.xRemainder, cell.yRemainder);
+    normal = cellNormal(cell, corners);
+}
+
+void PagedTerrain::getHeightsAndNormals(const float* x, const float* y, const size_t count, float* heights,
+                                        float* normalX, float* normalY, float* normalZ) const {
+    if (tileCount == 0) {
+        return;
+    }
+    for (size_t point = 0; point < count; point++) {
+        Cartesian3 normal;
+        getHeightAndNormal(x[point], y[point], heights[point], normal);
+        normalX[point] = normal.x;
+        normalY[point] = normal.y;
+        normalZ[point] = normal.z;
+    }
+}
+
+bool PagedTerrain::contains(const float x, const float y) const {
+    return gridContains(x, y, nRows, nColumns, xyScale);
+}
+
+void PagedTerrain::getExtent(float& minX, float& minY, float& maxX, float& maxY) const {
+    gridExtent(nRows, nColumns, xyScale, minX, minY, maxX, maxY);
+}
+
+bool PagedTerrain::mayReach(const float minX, const float minY, const float maxX, const float maxY,
+                            const float height) const {
+    if (tileCount == 0) {
+        return false;
+    }
+
+    // the squares under the corners of the box, and the tiles holding them
+    const GridCell topLeft = findCell(minX, maxY);
+    const GridCell bottomRight = findCell(maxX, minY);
+    const long firstTileRow = topLeft.row / tileSize;
+    const long lastTileRow = bottomRight.row / tileSize;
+    const long firstTileColumn = topLeft.column / tileSize;
+    const long lastTileColumn = bottomRight.column / tileSize;
+    for (long tileRow = firstTileRow; tileRow <= lastTileRow; tileRow++) {
+        for (long tileColumn = firstTileColumn; tileColumn <= lastTileColumn; tileColumn++) {
+            if (tileHighest[tileRow * tileColumns + tileColumn] >= height) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void PagedTerrain::prefetch(const Cartesian3& position, const Cartesian3& velocity, const float lookahead) const {
+    if (tileCount == 0) {
+        return;
+    }
+
+    // sample the path every half tile, so no tile it crosses is stepped over
+    const Cartesian3 path = velocity * lookahead;
+    const float distance = std::sqrt(path.x * path.x + path.y * path.y);
+    const long steps = std::min(static_cast<long>(std::ceil(distance / (0.5f * tileSize * xyScale))),
+                                static_cast<long>(tileCount));
+    const size_t maxPrefetched = std::max<size_t>(1, maxResidentTiles / 2);
+
+    size_t previousTile = tileCount;
+    size_t prefetched = 0;
+    for (long step = 0; step <= steps && prefetched < maxPrefetched; step++) {
+        const float along = steps == 0 ? 0.0f : static_cast<float>(step) / steps;
+        const GridCell cell = findCell(position.x + path.x * along, position.y + path.y * along);
+        const size_t tile = tileOf(cell.row, cell.column);
+        if (tile == previousTile) {
+            continue;
+        }
+        previousTile = tile;
+        TileState& state = tileStates[tile];
+        if (!state.isResident.exchange(true)) {
+            admitTile(tile);
+            file.prefetch(tilesOffset + tile * tileStride, tileStride);
+            prefetched++;
+        } else {
+            state.lastUse.store(clock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef PAGED_TERRAIN_H
+#define PAGED_TERRAIN_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Cartesian3.h"
+#include "HeightField.h"
+#include "HeightGrid.h"
+#include "MappedFile.h"
+
+// Header of the tiled .demt terrain format, little endian.
+// The rows x columns heights are cut into tiles of tileSize x tileSize grid squares, tileRows x tileColumns
+// of them, stored row after row from tilesOffset, tileStride bytes apart. Each tile holds
+// (tileSize + 1) x (tileSize + 1) float32 heights, row-major, sharing its last row and column with
+// the next tile so that every square lies in one tile; past the grid's edge the last height repeats.
+// tileStride is a whole number of 4 KB pages, so a tile can be paged in and out on its own.
+// At boundsOffset, after the tiles, the highest height of every tile, one float32 each in tile order.
+struct TiledTerrainFileHeader {
+    // "DEMT"
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t rows;
+    std::uint32_t columns;
+    std::uint32_t tileSize;
+    std::uint32_t tileRows;
+    std::uint32_t tileColumns;
+    std::uint32_t reserved;
+    std::uint64_t tileStride;
+    std::uint64_t tilesOffset;
+    std::uint64_t boundsOffset;
+};
+
+// Writes a .demt from any source of heights: readHeights(row, column, count, values) fills values
+// with count heights of row from column on. The source is read one tile at a time, so a grid
+// memory mapped from a .demb never has to fit in memory
+bool writeTiledTerrainFile(const char* fileName, long rows, long columns, long tileSize,
+                           const std::function<void(long row, long column, long count, float* values)>& readHeights);
+
+// The HeightField queries over a .demt terrain too large to hold in memory.
+// The file is memory mapped whole, so a query pages in only the tile it reads. Tiles read recently
+// are kept resident up to a memory budget; beyond it the least recently used are released back
+// to the file. prefetch pages in the tiles ahead of a moving point before it gets there.
+// Positions are centred like Terrain's, and every query answers exactly as a Terrain loaded from
+// the same heights would; points off the grid use its nearest edge square. mayReach is judged
+// per tile from the highest heights stored in the file, so it never pages a tile in.
+// Queries may run on many threads at once. A tile released while another thread reads it is
+// simply read from the file again.
+class PagedTerrain final : public HeightField {
+public:
+    float xyScale;
+
+    PagedTerrain();
+
+    // map a .demt, keeping up to memoryBudget bytes of tiles resident (at least one tile)
+    bool open(const char* fileName, float xyScale, size_t memoryBudget);
+
+    void setMemoryBudget(size_t memoryBudget);
+
+    long rows() const { return nRows; }
+    long columns() const { return nColumns; }
+
+    // tiles currently counted as resident, at most the budget's worth
+    size_t residentTileCount() const;
+
+    float getHeight(float x, float y) const override;
+
+    Cartesian3 getNormal(float x, float y) const override;
+
+    void getHeightAndNormal(float x, float y, float& height, Cartesian3& normal) const override;
+
+    // one point at a time, as getHeightAndNormal
+    void getHeightsAndNormals(const float* x, const float* y, size_t count, float* heights,
+                              float* normalX, float* normalY, float* normalZ) const override;
+
+    bool contains(float x, float y) const override;
+    void getExtent(float& minX, float& minY, float& maxX, float& maxY) const override;
+
+    bool mayReach(float minX, float minY, float maxX, float maxY, float height) const override;
+
+    // page in the tiles under the path from position along velocity for the next lookahead seconds,
+    // nearest first and at most half the budget's worth, without waiting for them
+    void prefetch(const Cartesian3& position, const Cartesian3& velocity, float lookahead) const override;
+
+private:
+    // recency of a tile, and whether it counts against the budget
+    struct TileState {
+        std::atomic<std::uint64_t> lastUse;
+        std::atomic<bool> isResident;
+    };
+
+    MappedFile file;
+    long nRows;
+    long nColumns;
+    long tileSize;
+    long tileColumns;
+    size_t tileStride;
+    size_t tilesOffset;
+    // highest height of each tile, copied out of the file
+    std::vector<float> tileHighest;
+
+    std::unique_ptr<TileState[]> tileStates;
+    size_t tileCount;
+    size_t maxResidentTiles;
+    // advances whenever a tile is paged in, and stamps the tiles each query reads
+    mutable std::atomic<std::uint64_t> clock;
+    mutable std::mutex residentMutex;
+    mutable std::vector<size_t> residentTiles;
+
+    // offset, flip and divide (x, y) into grid coordinates, clamped onto the grid (see findGridCell)
+    GridCell findCell(float x, float y) const;
+
+    size_t tileOf(long row, long column) const;
+
+    // heights of the tile, marking it used
+    const float* useTile(size_t tile) const;
+
+    // count a tile as resident, releasing the least recently used ones over the budget
+    void admitTile(size_t tile) const;
+
+    // release the least recently used resident tiles until keep are left, with residentMutex held
+    void releaseOldestTiles(size_t keep) const;
+
+    // corners of the cell's square, read from its tile
+    HeightSquare cellSquare(const GridCell& cell) const;
+
+    // normal of the triangle the cell point lies in, computed as Terrain computes its face normals
+    Cartesian3 cellNormal(const GridCell& cell, const HeightSquare& corners) const;
+};
+
+#endif
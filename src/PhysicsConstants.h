@@ -0,0 +1,24 @@
+#ifndef PHYSICS_CONSTANTS_H
+#define PHYSICS_CONSTANTS_H
+
+#include "Cartesian3.h"
+
+// permanent downwards vector for gravity
+const Cartesian3 gravity(0.0, 0.0, -9.8);
+
+// radius of the sphere
+constexpr float sphereRadius = 1.0f;
+
+// bounce properties
+constexpr float elasticity = 0.6f;
+
+// Coulomb friction between polyhedral balls and the terrain
+constexpr float frictionCoefficient = 0.5f;
+
+// A ball whose average speed stays under sleepSpeed for longer than sleepDelay seconds is put to sleep
+// and no longer stepped. Averaging over the window ignores the small hops of a ball resting on the terrain,
+// while a ball in free flight never stays within sleepSpeed * sleepDelay of one point for that long
+constexpr float sleepSpeed = 0.1f;
+constexpr float sleepDelay = 0.5f;
+
+#endif
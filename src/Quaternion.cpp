@@ -106,6 +106,33 @@ Quaternion operator *(float scalar, const Quaternion& quat) {
     return result;
 }
 
+Quaternion slerp(const Quaternion& from, const Quaternion& to, const float t) {
+    float cosTheta = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        cosTheta += from.q[i] * to.q[i];
+    }
+    // q and -q are the same rotation: take the one on the near side
+    const float sign = cosTheta < 0.0f ? -1.0f : 1.0f;
+    cosTheta *= sign;
+
+    float fromWeight = 1.0f - t;
+    float toWeight = t;
+    // nearly parallel quaternions are blended linearly, which avoids dividing by sin(theta) ~ 0
+    if (cosTheta < 0.9995f) {
+        const float theta = std::acos(cosTheta);
+        const float sinTheta = std::sin(theta);
+        fromWeight = std::sin((1.0f - t) * theta) / sinTheta;
+        toWeight = std::sin(t * theta) / sinTheta;
+    }
+
+    Quaternion result;
+    for (int i = 0; i < 4; i++) {
+        result.q[i] = fromWeight * from.q[i] + sign * toWeight * to.q[i];
+    }
+    // renormalise, as the linear blend shortens the quaternion slightly
+    return result / std::sqrt(result.norm());
+}
+
 Quaternion Quaternion::operator *(const float scalar) const {
     Quaternion result;
     for (int i = 0; i < 4; i++) {
@@ -65,6 +65,9 @@ public:
 
 Quaternion operator *(float scalar, const Quaternion& quat);
 
+// Rotation a fraction t of the way from one unit quaternion to another, along the shorter arc
+Quaternion slerp(const Quaternion& from, const Quaternion& to, float t);
+
 std::ostream& operator <<(std::ostream& outStream, const Quaternion& quat);
 
 #endif
@@ -0,0 +1,113 @@
+#include "RigidBody.h"
+
+// surfaces enclosing less than this fraction of their bounding sphere's cube hold no real volume
+constexpr double minimumRelativeVolume = 1.0e-6;
+
+RigidBody::RigidBody()
+    : mass(1.0f),
+      volume(0.0f) {
+    setOrientation(Quaternion());
+}
+
+void RigidBody::setShape(const IndexedFaceSurface& model, const float bodyMass) {
+    mass = bodyMass;
+    supportMap.build(model);
+
+    // The solid is the signed sum of the tetrahedra joining the origin to each face, so its volume,
+    // first moments and second moments (sum of x_i x_j dV) are sums of closed-form tetrahedron terms.
+    // Accumulated in double, as the terms of a fine mesh largely cancel
+    double totalVolume = 0.0;
+    double firstMoments[3] = {0.0, 0.0, 0.0};
+    double secondMoments[3][3] = {};
+    for (size_t face = 0; face + 2 < model.faceVertices.size(); face += 3) {
+        double corners[3][3];
+        for (int corner = 0; corner < 3; corner++) {
+            const Cartesian3& vertex = model.vertices[model.faceVertices[face + corner]];
+            for (int axis = 0; axis < 3; axis++) {
+                corners[corner][axis] = vertex[axis];
+            }
+        }
+        const double* a = corners[0];
+        const double* b = corners[1];
+        const double* c = corners[2];
+
+        const double tetrahedronVolume = (a[0] * (b[1] * c[2] - b[2] * c[1]) +
+                                          a[1] * (b[2] * c[0] - b[0] * c[2]) +
+                                          a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0;
+        totalVolume += tetrahedronVolume;
+        for (int row = 0; row < 3; row++) {
+            const double sumRow = a[row] + b[row] + c[row];
+            firstMoments[row] += tetrahedronVolume * sumRow / 4.0;
+            for (int col = 0; col < 3; col++) {
+                const double sumCol = a[col] + b[col] + c[col];
+                secondMoments[row][col] += tetrahedronVolume / 20.0 *
+                                           (a[row] * a[col] + b[row] * b[col] + c[row] * c[col] + sumRow * sumCol);
+            }
+        }
+    }
+
+    // inside-out faces describe the same solid with every sign flipped
+    const double sign = totalVolume < 0.0 ? -1.0 : 1.0;
+    totalVolume *= sign;
+
+    // second moments about the centre of mass, for the whole body mass
+    double centre[3] = {0.0, 0.0, 0.0};
+    double moments[3][3] = {};
+    const double radius = model.boundingSphereRadius;
+    if (totalVolume > minimumRelativeVolume * radius * radius * radius) {
+        const double density = mass / totalVolume;
+        for (int row = 0; row < 3; row++) {
+            centre[row] = sign * firstMoments[row] / totalVolume;
+        }
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                moments[row][col] = density * (sign * secondMoments[row][col] - totalVolume * centre[row] * centre[col]);
+            }
+        }
+        volume = static_cast<float>(totalVolume);
+    } else if (!model.vertices.empty()) {
+        const double vertexMass = static_cast<double>(mass) / model.vertices.size();
+        for (const auto& vertex : model.vertices) {
+            for (int row = 0; row < 3; row++) {
+                centre[row] += vertex[row] / model.vertices.size();
+            }
+        }
+        for (const auto& vertex : model.vertices) {
+            for (int row = 0; row < 3; row++) {
+                for (int col = 0; col < 3; col++) {
+                    moments[row][col] += vertexMass * (vertex[row] - centre[row]) * (vertex[col] - centre[col]);
+                }
+            }
+        }
+        volume = 0.0f;
+    }
+
+    // inertia tensor = trace(moments) * identity - moments
+    const double trace = moments[0][0] + moments[1][1] + moments[2][2];
+    for (int row = 0; row < 3; row++) {
+        centreOfMass[row] = static_cast<float>(centre[row]);
+        for (int col = 0; col < 3; col++) {
+            inertia[row][col] = static_cast<float>((row == col ? trace : 0.0) - moments[row][col]);
+        }
+    }
+    inverseInertia = inertia.inverse();
+    worldInverseInertia = rotation * inverseInertia * rotation.transpose();
+}
+
+void RigidBody::setOrientation(const Quaternion& orientation) {
+    rotation = orientation.asMatrix().asMatrix3();
+    worldInverseInertia = rotation * inverseInertia * rotation.transpose();
+}
+
+Cartesian3 RigidBody::supportOffset(const Cartesian3& direction, int& hint) const {
+    hint = supportMap.support(rotation.transpose() * direction, hint);
+    return rotation * supportMap.vertex(hint);
+}
+
+float RigidBody::inverseMassAlong(const Cartesian3& offset, const Cartesian3& direction) const {
+    return 1.0f / mass + direction.dot((worldInverseInertia * offset.cross(direction)).cross(offset));
+}
+
+Cartesian3 RigidBody::angularVelocityChange(const Cartesian3& offset, const Cartesian3& impulse) const {
+    return worldInverseInertia * offset.cross(impulse);
+}
@@ -0,0 +1,50 @@
+#ifndef RIGID_BODY_H
+#define RIGID_BODY_H
+
+#include "Cartesian3.h"
+#include "IndexedFaceSurface.h"
+#include "Matrix3.h"
+#include "Quaternion.h"
+#include "SupportMap.h"
+
+// Mass properties of a ball model, computed once per model, and the world space quantities
+// derived from them, refreshed once per step instead of at every contact.
+class RigidBody {
+public:
+    // body space, fixed by setShape()
+    float mass;
+    float volume;
+    Cartesian3 centreOfMass;
+    // about the centre of mass
+    Matrix3 inertia;
+    Matrix3 inverseInertia;
+    // vertex graph of the model, see supportOffset()
+    SupportMap supportMap;
+
+    // world space, refreshed by setOrientation()
+    Matrix3 rotation;
+    // R * inverseInertia * R^T
+    Matrix3 worldInverseInertia;
+
+    RigidBody();
+
+    // Mass properties and support map of the closed surface model filled with uniform density, scaled to bodyMass.
+    // A surface enclosing no volume (open or degenerate) falls back to equal point masses at its vertices
+    void setShape(const IndexedFaceSurface& model, float bodyMass);
+
+    // rotation and world inverse inertia for a new orientation
+    void setOrientation(const Quaternion& orientation);
+
+    // inverse of the mass an impulse along direction meets when applied at a world space offset
+    // from the centre of mass: 1 / mass plus what turning the body absorbs
+    float inverseMassAlong(const Cartesian3& offset, const Cartesian3& direction) const;
+
+    // World space offset from the body origin of a vertex farthest along a world space direction.
+    // The search climbs from hint, which is set to the vertex found for the next call to start from
+    Cartesian3 supportOffset(const Cartesian3& direction, int& hint) const;
+
+    // change of angular velocity from an impulse applied at a world space offset from the centre of mass
+    Cartesian3 angularVelocityChange(const Cartesian3& offset, const Cartesian3& impulse) const;
+};
+
+#endif
@@ -1,10 +1,7 @@
 #include "Scene.h"
 
+#include <algorithm>
 #include <array>
-#include <limits>
-#include <cmath>
-
-#include "Quaternion.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -28,23 +25,13 @@ const std::string dodecahedronModelName = "assets/dodecahedron.face";
 // the speed of camera movement
 constexpr float cameraSpeed = 5.0f;
 
-// this is 60 fps nominal speed
-constexpr float frameTime = 0.0166667f;
-
-// permanent downwards vector for gravity
-const Cartesian3 gravity(0.0, 0.0, -9.8);
-
-// radius of the sphere
-constexpr float sphereRadius = 1.0f;
+// physics frame, split into subSteps equal steps
+constexpr float physicsFrameTime = 0.0166667f;
+constexpr int maxSubSteps = 16;
 
-// bounce properties
-constexpr float elasticity = 0.6f;
-
-// initial ball position
-const Cartesian3 initialBallPosition(0.0f, 0.0f, 10.0f);
-const Cartesian3 initialBallVelocity(5.0f, 0.0f, 0.0f);
-const Quaternion initialBallOrientation({0.0f, 0.0f, 1.0f}, 0.0f);
-const Cartesian3 initialBallAngularVelocity(0.0f, 0.0f, 0.0f);
+// longest wall-clock gap simulated in one update(); after a longer stall the simulation falls
+// behind instead of freezing the window while it catches up
+constexpr float maxElapsedTime = 0.25f;
 
 const Homogeneous4 sunDirection(0.5, -0.5, 0.3, 0.0);
 constexpr std::array<float, 4> groundColour{0.2, 0.5, 0.2, 1.0};
@@ -53,83 +40,79 @@ constexpr std::array<float, 4> sunAmbient{0.1, 0.1, 0.1, 1.0};
 constexpr std::array<float, 4> sunDiffuse{0.7, 0.7, 0.7, 1.0};
 constexpr std::array<float, 4> blackColour{0.0, 0.0, 0.0, 1.0};
 
+// render all triangles of a surface with flat shading
+static void renderSurface(const IndexedFaceSurface& surface) {
+    glBegin(GL_TRIANGLES);
+
+    for (size_t triangle = 0; triangle < surface.normals.size(); triangle++) {
+        glNormal3fv(&surface.normals[triangle].x);
+        glVertex3fv(&surface.vertices[surface.faceVertices[3 * triangle]].x);
+        glVertex3fv(&surface.vertices[surface.faceVertices[3 * triangle + 1]].x);
+        glVertex3fv(&surface.vertices[surface.faceVertices[3 * triangle + 2]].x);
+    }
+
+    glEnd();
+}
+
+// render a terrain from its grid, which works whether or not it stores its mesh
+static void renderTerrain(const Terrain& terrain) {
+    glBegin(GL_TRIANGLES);
+
+    for (size_t face = 0; face < terrain.faceCount(); face++) {
+        const Cartesian3 normal = terrain.faceNormal(face);
+        Cartesian3 corners[3];
+        terrain.faceCorners(face, corners);
+        glNormal3fv(&normal.x);
+        for (const Cartesian3& corner : corners) {
+            glVertex3fv(&corner.x);
+        }
+    }
+
+    glEnd();
+}
+
 // constructor
 Scene::Scene() {
-    sphere.readIndexedFaceFile(sphereModelName.data());
-    dodecahedron.readIndexedFaceFile(dodecahedronModelName.data());
-    flatLand.readTerrainFile(flatLandModelName.data(), 3);
-    stripeLand.readTerrainFile(stripeLandModelName.data(), 3);
-    rollingLand.readTerrainFile(rollingLandModelName.data(), 3);
+    // loaders report the details of malformed files themselves
+    if (!sphere.readIndexedFaceFile(sphereModelName.data())) {
+        throw "Unable to read " + sphereModelName;
+    }
+    if (!dodecahedron.readIndexedFaceFile(dodecahedronModelName.data())) {
+        throw "Unable to read " + dodecahedronModelName;
+    }
+    if (!flatLand.readTerrainFile(flatLandModelName.data(), 3)) {
+        throw "Unable to read " + flatLandModelName;
+    }
+    if (!stripeLand.readTerrainFile(stripeLandModelName.data(), 3)) {
+        throw "Unable to read " + stripeLandModelName;
+    }
+    if (!rollingLand.readTerrainFile(rollingLandModelName.data(), 3)) {
+        throw "Unable to read " + rollingLandModelName;
+    }
 
     // initial active terrain is flat
     activeTerrain = &flatLand;
     viewMatrix = Matrix4::translation(Cartesian3(0.0, 15.0, -10.0));
-    frameNumber = 0;
+
     // show sphere as default
-    useSphere = true;
-    launchAngle = 0.0f;
+    simulation.terrain = activeTerrain;
+    simulation.ballModel = &sphere;
+    simulation.useSphere = true;
+    simulation.launchAngle = 0.0f;
+
+    setSubSteps(1);
 
     resetPhysics();
 }
 
-void Scene::update() {
-    frameNumber++;
-
-    // Gravity is a permanent force
-    ballVelocity = ballVelocity + gravity * frameTime;
-
-    // The rest depends on whether we have the sphere or the dodecahedron.
-    // For simplicity, we will code it redundantly
-    if (useSphere) {
-        // if colliding against the terrain, apply bounce impulse instantaneously
-        const float terrainHeight = activeTerrain->getHeight(ballPosition.x, ballPosition.y);
-        const float dz = ballPosition.z - terrainHeight;
-        const bool isBallColliding = dz < sphereRadius || std::abs(dz) < std::numeric_limits<float>::epsilon();
-        if (isBallColliding) {
-            const Cartesian3 terrainNormal = activeTerrain->getNormal(ballPosition.x, ballPosition.y);
-            const Cartesian3 bounceImpulse = -(1.0f + elasticity) * ballVelocity.dot(terrainNormal) * terrainNormal;
-            ballVelocity = ballVelocity + bounceImpulse;
-            // Snap the sphere on top of the terrain to avoid penetration
-            ballPosition.z = terrainHeight + sphereRadius;
-        }
-    } else {
-        // Find the vertex that is colliding deepest inside the terrain
-        const float terrainHeight = activeTerrain->getHeight(ballPosition.x, ballPosition.y);
-        const Cartesian3 terrainPoint(ballPosition.x, ballPosition.y, terrainHeight);
-        const Cartesian3 terrainNormal = activeTerrain->getNormal(ballPosition.x, ballPosition.y);
-        float minProjection = std::numeric_limits<float>::infinity();
-        Cartesian3 deepestVertex;
-        for (const auto& vertice : dodecahedron.vertices) {
-            const Cartesian3 vertexWcs = Matrix4::translation(ballPosition) * ballOrientation.asMatrix() * vertice;
-            const Cartesian3 terrainToVertex = vertexWcs - terrainPoint;
-            if (const float distance = terrainToVertex.dot(terrainNormal); distance < minProjection) {
-                minProjection = distance;
-                deepestVertex = vertice;
-            }
-        }
-
-        // If half-space test is < 0, means that the point is in the opposite side of the terrain
-        // Therefore, it is colliding with the terrain
-        const bool isDodecahedronColliding = minProjection < 0.0f;
-        if (isDodecahedronColliding) {
-            const Cartesian3 bounceImpulse = -(1.0f + elasticity) * ballVelocity.dot(terrainNormal) * terrainNormal;
-            ballVelocity = ballVelocity + bounceImpulse;
-            const Matrix3 inertia = ballOrientation.asMatrix().asMatrix3() * dodecahedron.inertialTensor() *
-                                    ballOrientation.asMatrix().asMatrix3().transpose();
-            ballAngularVelocity = ballAngularVelocity + inertia.inverse() * deepestVertex.cross(bounceImpulse);
-            // Snap the dodecahedron on top of the terrain to avoid penetration
-            ballPosition = ballPosition + std::abs(minProjection) * terrainNormal;
-        }
-
-        // Update rotation, avoiding ||w|| = 0 edge case
-        if (ballAngularVelocity.length() > 0.0f) {
-            ballOrientation = ballOrientation * Quaternion(ballAngularVelocity.unit(),
-                                                           ballAngularVelocity.length() * frameTime);
-        }
+void Scene::update(const float elapsedSeconds) {
+    accumulatedTime += std::min(elapsedSeconds, maxElapsedTime);
+    while (accumulatedTime >= simulation.frameTime) {
+        previousBallPosition = simulation.ballPosition;
+        previousBallOrientation = simulation.ballOrientation;
+        simulation.update();
+        accumulatedTime -= simulation.frameTime;
     }
-
-    // After calculating velocity, update position with it
-    ballPosition = ballPosition + ballVelocity * frameTime;
 }
 
 // routine to tell the scene to render itself
@@ -173,21 +156,26 @@ void Scene::render() {
     glMaterialfv(GL_FRONT, GL_EMISSION, blackColour.data());
 
     // render the terrain
-    activeTerrain->render();
+    renderTerrain(*activeTerrain);
 
     // set the colour for the ball
     glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, ballColour.data());
 
+    // the ball is drawn where it is between the last two steps, as far along as the time left over
+    // an event-driven flight knows its exact position at any time, so sample it at that same time instead
+    const float blend = accumulatedTime / simulation.frameTime;
+    Cartesian3 ballPosition = previousBallPosition + (simulation.ballPosition - previousBallPosition) * blend;
+    Cartesian3 ballVelocity;
+    const float renderTime = simulation.elapsedTime - simulation.frameTime + accumulatedTime;
+    simulation.sampleFlight(renderTime, ballPosition, ballVelocity);
+    const Quaternion ballOrientation = slerp(previousBallOrientation, simulation.ballOrientation, blend);
+
     // and update the modelview matrix
     glTranslatef(ballPosition.x, ballPosition.y, ballPosition.z);
     glMultMatrixf(reinterpret_cast<GLfloat*>(ballOrientation.asMatrix().columnMajor().coordinates));
 
     // now render the ball
-    if (useSphere) {
-        sphere.render();
-    } else {
-        dodecahedron.render();
-    }
+    renderSurface(*simulation.ballModel);
 }
 
 void Scene::eventCameraForward() {
@@ -252,10 +240,10 @@ void Scene::eventCameraTurnRight() {
 
 
 void Scene::resetPhysics() {
-    ballPosition = initialBallPosition;
-    ballVelocity = Matrix4::rotationZ(launchAngle) * initialBallVelocity;
-    ballOrientation = initialBallOrientation;
-    ballAngularVelocity = initialBallAngularVelocity;
+    simulation.reset();
+    accumulatedTime = 0.0f;
+    previousBallPosition = simulation.ballPosition;
+    previousBallOrientation = simulation.ballOrientation;
 }
 
 void Scene::switchTerrain() {
@@ -266,17 +254,46 @@ void Scene::switchTerrain() {
     } else if (activeTerrain == &rollingLand) {
         activeTerrain = &flatLand;
     }
+    simulation.terrain = activeTerrain;
+    // a ball asleep on the old terrain has to find the new one
+    simulation.wake();
 }
 
 void Scene::switchModel() {
-    useSphere = !useSphere;
+    simulation.useSphere = !simulation.useSphere;
+    simulation.ballModel = simulation.useSphere ? &sphere : &dodecahedron;
     resetPhysics();
 }
 
+void Scene::switchCollisionMode() {
+    simulation.continuousCollision = !simulation.continuousCollision;
+}
+
+void Scene::switchEventDriven() {
+    simulation.eventDriven = !simulation.eventDriven;
+}
+
+void Scene::increaseSubSteps() {
+    setSubSteps(std::min(subSteps * 2, maxSubSteps));
+}
+
+void Scene::decreaseSubSteps() {
+    setSubSteps(std::max(subSteps / 2, 1));
+}
+
+void Scene::setSubSteps(const int steps) {
+    subSteps = steps;
+    simulation.frameTime = physicsFrameTime / subSteps;
+    // the leftover time and previous pose belong to the old step size
+    accumulatedTime = 0.0f;
+    previousBallPosition = simulation.ballPosition;
+    previousBallOrientation = simulation.ballOrientation;
+}
+
 void Scene::rotateLaunchLeft() {
-    launchAngle -= 5.0;
+    simulation.launchAngle -= 5.0;
 }
 
 void Scene::rotateLaunchRight() {
-    launchAngle += 5.0;
+    simulation.launchAngle += 5.0;
 }
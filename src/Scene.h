@@ -4,13 +4,14 @@
 #include "IndexedFaceSurface.h"
 #include "Terrain.h"
 #include "Matrix4.h"
-#include "Quaternion.h"
+#include "Simulation.h"
 
 class Scene {
 public:
     Scene();
 
-    void update();
+    // advance the physics by the wall-clock time since the last call, in fixed steps
+    void update(float elapsedSeconds);
 
     void render();
 
@@ -40,6 +41,14 @@ public:
 
     void switchModel();
 
+    void switchCollisionMode();
+
+    void switchEventDriven();
+
+    void increaseSubSteps();
+
+    void decreaseSubSteps();
+
     void rotateLaunchLeft();
 
     void rotateLaunchRight();
@@ -54,23 +63,22 @@ private:
     IndexedFaceSurface sphere;
     IndexedFaceSurface dodecahedron;
 
-    // true -> show sphere, false -> show dodecahedron
-    bool useSphere;
+    Matrix4 viewMatrix;
 
-    // angle of launch of ball (rotation around Z)
-    float launchAngle;
+    // ball physics, including the active terrain, model and launch angle
+    Simulation simulation;
 
-    Matrix4 viewMatrix;
+    // physics steps per 1/60 s frame; more steps cost more CPU but track contacts more closely
+    int subSteps;
+
+    // wall-clock time not yet simulated, always less than one step after update()
+    float accumulatedTime;
 
-    // the frame number for use in animating
-    unsigned long frameNumber;
+    // ball pose before the last step, blended with the current one when rendering between steps
+    Cartesian3 previousBallPosition;
+    Quaternion previousBallOrientation;
 
-    // ball properties
-    Cartesian3 ballPosition;
-    // it is assumed mass = 1 => velocity is effectively linear momentum
-    Cartesian3 ballVelocity;
-    Quaternion ballOrientation;
-    Cartesian3 ballAngularVelocity;
+    void setSubSteps(int steps);
 };
 
 #endif
@@ -0,0 +1,424 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin wrapper over the widest float vector the compiler targets:
+// AVX-512 (16 lanes), AVX (8 lanes), SSE (4 lanes) or plain scalar code.
+// Build with CONFIG+=native_simd (or -mavx2 / -mavx512f) to enable the wider paths.
+// Integer lanes (SimdInt) and gathers need AVX2 or AVX-512; SIMD_HAS_GATHER is defined when they exist.
+
+#include <cstdint>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#else
+#include <cmath>
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#define SIMD_HAS_GATHER 1
+#endif
+
+class SimdFloat;
+class SimdInt;
+
+// per-lane boolean produced by comparisons
+class SimdMask {
+public:
+#if defined(__AVX512F__)
+    __mmask16 value;
+#elif defined(__AVX__)
+    __m256 value;
+#elif defined(__SSE2__)
+    __m128 value;
+#else
+    bool value;
+#endif
+};
+
+class SimdFloat {
+public:
+#if defined(__AVX512F__)
+    static constexpr int width = 16;
+    __m512 value;
+#elif defined(__AVX__)
+    static constexpr int width = 8;
+    __m256 value;
+#elif defined(__SSE2__)
+    static constexpr int width = 4;
+    __m128 value;
+#else
+    static constexpr int width = 1;
+    float value;
+#endif
+
+    SimdFloat() = default;
+
+    // broadcast the same value to every lane
+    explicit SimdFloat(const float scalar) {
+#if defined(__AVX512F__)
+        value = _mm512_set1_ps(scalar);
+#elif defined(__AVX__)
+        value = _mm256_set1_ps(scalar);
+#elif defined(__SSE2__)
+        value = _mm_set1_ps(scalar);
+#else
+        value = scalar;
+#endif
+    }
+
+    // unaligned load of width consecutive floats
+    static SimdFloat load(const float* source) {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_loadu_ps(source);
+#elif defined(__AVX__)
+        result.value = _mm256_loadu_ps(source);
+#elif defined(__SSE2__)
+        result.value = _mm_loadu_ps(source);
+#else
+        result.value = *source;
+#endif
+        return result;
+    }
+
+    // unaligned store of width consecutive floats
+    void store(float* destination) const {
+#if defined(__AVX512F__)
+        _mm512_storeu_ps(destination, value);
+#elif defined(__AVX__)
+        _mm256_storeu_ps(destination, value);
+#elif defined(__SSE2__)
+        _mm_storeu_ps(destination, value);
+#else
+        *destination = value;
+#endif
+    }
+
+    SimdFloat operator +(const SimdFloat& other) const {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_add_ps(value, other.value);
+#elif defined(__AVX__)
+        result.value = _mm256_add_ps(value, other.value);
+#elif defined(__SSE2__)
+        result.value = _mm_add_ps(value, other.value);
+#else
+        result.value = value + other.value;
+#endif
+        return result;
+    }
+
+    SimdFloat operator -(const SimdFloat& other) const {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_sub_ps(value, other.value);
+#elif defined(__AVX__)
+        result.value = _mm256_sub_ps(value, other.value);
+#elif defined(__SSE2__)
+        result.value = _mm_sub_ps(value, other.value);
+#else
+        result.value = value - other.value;
+#endif
+        return result;
+    }
+
+    SimdFloat operator *(const SimdFloat& other) const {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_mul_ps(value, other.value);
+#elif defined(__AVX__)
+        result.value = _mm256_mul_ps(value, other.value);
+#elif defined(__SSE2__)
+        result.value = _mm_mul_ps(value, other.value);
+#else
+        result.value = value * other.value;
+#endif
+        return result;
+    }
+
+    SimdFloat operator /(const SimdFloat& other) const {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_div_ps(value, other.value);
+#elif defined(__AVX__)
+        result.value = _mm256_div_ps(value, other.value);
+#elif defined(__SSE2__)
+        result.value = _mm_div_ps(value, other.value);
+#else
+        result.value = value / other.value;
+#endif
+        return result;
+    }
+
+    SimdMask operator <(const SimdFloat& other) const {
+        SimdMask result;
+#if defined(__AVX512F__)
+        result.value = _mm512_cmp_ps_mask(value, other.value, _CMP_LT_OQ);
+#elif defined(__AVX__)
+        result.value = _mm256_cmp_ps(value, other.value, _CMP_LT_OQ);
+#elif defined(__SSE2__)
+        result.value = _mm_cmplt_ps(value, other.value);
+#else
+        result.value = value < other.value;
+#endif
+        return result;
+    }
+
+    // per lane: mask ? ifTrue : ifFalse
+    static SimdFloat select(const SimdMask& mask, const SimdFloat& ifTrue, const SimdFloat& ifFalse) {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_mask_blend_ps(mask.value, ifFalse.value, ifTrue.value);
+#elif defined(__AVX__)
+        result.value = _mm256_blendv_ps(ifFalse.value, ifTrue.value, mask.value);
+#elif defined(__SSE2__)
+        result.value = _mm_or_ps(_mm_and_ps(mask.value, ifTrue.value), _mm_andnot_ps(mask.value, ifFalse.value));
+#else
+        result.value = mask.value ? ifTrue.value : ifFalse.value;
+#endif
+        return result;
+    }
+
+    static SimdFloat min(const SimdFloat& first, const SimdFloat& second) {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_min_ps(first.value, second.value);
+#elif defined(__AVX__)
+        result.value = _mm256_min_ps(first.value, second.value);
+#elif defined(__SSE2__)
+        result.value = _mm_min_ps(first.value, second.value);
+#else
+        result.value = first.value < second.value ? first.value : second.value;
+#endif
+        return result;
+    }
+
+    static SimdFloat max(const SimdFloat& first, const SimdFloat& second) {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_max_ps(first.value, second.value);
+#elif defined(__AVX__)
+        result.value = _mm256_max_ps(first.value, second.value);
+#elif defined(__SSE2__)
+        result.value = _mm_max_ps(first.value, second.value);
+#else
+        result.value = first.value > second.value ? first.value : second.value;
+#endif
+        return result;
+    }
+
+    static SimdFloat sqrt(const SimdFloat& source) {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_sqrt_ps(source.value);
+#elif defined(__AVX__)
+        result.value = _mm256_sqrt_ps(source.value);
+#elif defined(__SSE2__)
+        result.value = _mm_sqrt_ps(source.value);
+#else
+        result.value = std::sqrt(source.value);
+#endif
+        return result;
+    }
+
+    // smallest and largest of all lanes, folding halves together
+    float minimum() const {
+#if defined(__AVX512F__)
+        return _mm512_reduce_min_ps(value);
+#elif defined(__AVX__)
+        __m256 folded = _mm256_min_ps(value, _mm256_permute2f128_ps(value, value, 1));
+        folded = _mm256_min_ps(folded, _mm256_shuffle_ps(folded, folded, _MM_SHUFFLE(1, 0, 3, 2)));
+        folded = _mm256_min_ps(folded, _mm256_shuffle_ps(folded, folded, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm256_cvtss_f32(folded);
+#elif defined(__SSE2__)
+        __m128 folded = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+        folded = _mm_min_ps(folded, _mm_shuffle_ps(folded, folded, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(folded);
+#else
+        return value;
+#endif
+    }
+
+    float maximum() const {
+#if defined(__AVX512F__)
+        return _mm512_reduce_max_ps(value);
+#elif defined(__AVX__)
+        __m256 folded = _mm256_max_ps(value, _mm256_permute2f128_ps(value, value, 1));
+        folded = _mm256_max_ps(folded, _mm256_shuffle_ps(folded, folded, _MM_SHUFFLE(1, 0, 3, 2)));
+        folded = _mm256_max_ps(folded, _mm256_shuffle_ps(folded, folded, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm256_cvtss_f32(folded);
+#elif defined(__SSE2__)
+        __m128 folded = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+        folded = _mm_max_ps(folded, _mm_shuffle_ps(folded, folded, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(folded);
+#else
+        return value;
+#endif
+    }
+
+#ifdef SIMD_HAS_GATHER
+    // per lane: base[index]
+    static SimdFloat gather(const float* base, const SimdInt& index);
+#endif
+};
+
+#ifdef SIMD_HAS_GATHER
+// int32 lanes, as many as SimdFloat has
+class SimdInt {
+public:
+#if defined(__AVX512F__)
+    __m512i value;
+#else
+    __m256i value;
+#endif
+
+    SimdInt() = default;
+
+    // broadcast the same value to every lane
+    explicit SimdInt(const int scalar) {
+#if defined(__AVX512F__)
+        value = _mm512_set1_epi32(scalar);
+#else
+        value = _mm256_set1_epi32(scalar);
+#endif
+    }
+
+    // convert rounding towards zero, like a cast from float to int
+    static SimdInt truncate(const SimdFloat& source) {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_cvttps_epi32(source.value);
+#else
+        result.value = _mm256_cvttps_epi32(source.value);
+#endif
+        return result;
+    }
+
+    SimdFloat toFloat() const {
+        SimdFloat result;
+#if defined(__AVX512F__)
+        result.value = _mm512_cvtepi32_ps(value);
+#else
+        result.value = _mm256_cvtepi32_ps(value);
+#endif
+        return result;
+    }
+
+    SimdInt operator +(const SimdInt& other) const {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_add_epi32(value, other.value);
+#else
+        result.value = _mm256_add_epi32(value, other.value);
+#endif
+        return result;
+    }
+
+    SimdInt operator *(const SimdInt& other) const {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_mullo_epi32(value, other.value);
+#else
+        result.value = _mm256_mullo_epi32(value, other.value);
+#endif
+        return result;
+    }
+
+    SimdInt operator &(const SimdInt& other) const {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_and_si512(value, other.value);
+#else
+        result.value = _mm256_and_si256(value, other.value);
+#endif
+        return result;
+    }
+
+    SimdInt operator |(const SimdInt& other) const {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_or_si512(value, other.value);
+#else
+        result.value = _mm256_or_si256(value, other.value);
+#endif
+        return result;
+    }
+
+    SimdInt operator <<(const int bits) const {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_sll_epi32(value, _mm_cvtsi32_si128(bits));
+#else
+        result.value = _mm256_sll_epi32(value, _mm_cvtsi32_si128(bits));
+#endif
+        return result;
+    }
+
+    // arithmetic shift, keeping the sign
+    SimdInt operator >>(const int bits) const {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_sra_epi32(value, _mm_cvtsi32_si128(bits));
+#else
+        result.value = _mm256_sra_epi32(value, _mm_cvtsi32_si128(bits));
+#endif
+        return result;
+    }
+
+    static SimdInt min(const SimdInt& first, const SimdInt& second) {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_min_epi32(first.value, second.value);
+#else
+        result.value = _mm256_min_epi32(first.value, second.value);
+#endif
+        return result;
+    }
+
+    static SimdInt max(const SimdInt& first, const SimdInt& second) {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_max_epi32(first.value, second.value);
+#else
+        result.value = _mm256_max_epi32(first.value, second.value);
+#endif
+        return result;
+    }
+
+    // per lane: mask ? ifTrue : ifFalse
+    static SimdInt select(const SimdMask& mask, const SimdInt& ifTrue, const SimdInt& ifFalse) {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_mask_blend_epi32(mask.value, ifFalse.value, ifTrue.value);
+#else
+        result.value = _mm256_blendv_epi8(ifFalse.value, ifTrue.value, _mm256_castps_si256(mask.value));
+#endif
+        return result;
+    }
+
+    // Per lane: base[index], zero extended. Each lane loads 32 bits and keeps the low half,
+    // so base needs one readable value after the last index
+    static SimdInt gather(const std::uint16_t* base, const SimdInt& index) {
+        SimdInt result;
+#if defined(__AVX512F__)
+        result.value = _mm512_and_si512(_mm512_i32gather_epi32(index.value, base, 2), _mm512_set1_epi32(0xFFFF));
+#else
+        result.value = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(base), index.value, 2),
+                                        _mm256_set1_epi32(0xFFFF));
+#endif
+        return result;
+    }
+};
+
+inline SimdFloat SimdFloat::gather(const float* base, const SimdInt& index) {
+    SimdFloat result;
+#if defined(__AVX512F__)
+    result.value = _mm512_i32gather_ps(index.value, base, 4);
+#else
+    result.value = _mm256_i32gather_ps(base, index.value, 4);
+#endif
+    return result;
+}
+#endif
+
+#endif
@@ -0,0 +1,377 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "PhysicsConstants.h"
+#include "Terrain.h"
+
+// this is 60 fps nominal speed
+constexpr float defaultFrameTime = 0.0166667f;
+
+// contacts approaching slower than this are resting contact rather than a new bounce
+constexpr float bounceSpeedThreshold = 0.5f;
+
+// frames without contact that still count as touching the terrain
+constexpr unsigned long contactFrameTolerance = 2;
+
+// continuous collision: contacts resolved within one update before the rest of the frame is dropped
+constexpr int maxContactsPerFrame = 4;
+
+// event-driven flight: largest gap allowed between the parabola and the chords it is swept along
+constexpr float flightTolerance = 1.0e-3f;
+
+// event-driven flight: longest flight solved ahead, in seconds
+constexpr float maxFlightTime = 600.0f;
+
+// how often the terrain is told where the ball is heading, in frames, and how far ahead, in seconds
+constexpr unsigned long prefetchFrames = 30;
+constexpr float prefetchLookahead = 2.0f;
+
+// initial ball position
+const Cartesian3 initialBallPosition(0.0f, 0.0f, 10.0f);
+const Cartesian3 initialBallVelocity(5.0f, 0.0f, 0.0f);
+const Quaternion initialBallOrientation({0.0f, 0.0f, 1.0f}, 0.0f);
+const Cartesian3 initialBallAngularVelocity(0.0f, 0.0f, 0.0f);
+
+const char* simulationOutcomeName(const SimulationOutcome outcome) {
+    switch (outcome) {
+        case SimulationOutcome::AtRest:
+            return "rest";
+        case SimulationOutcome::OffTerrain:
+            return "offmap";
+        default:
+            return "timeout";
+    }
+}
+
+Simulation::Simulation()
+    : terrain(nullptr),
+      ballModel(nullptr),
+      useSphere(true),
+      continuousCollision(false),
+      eventDriven(false),
+      integrator(Integrator::SemiImplicitEuler),
+      frameTime(defaultFrameTime),
+      launchAngle(0.0f),
+      launchPosition(initialBallPosition),
+      launchVelocity(initialBallVelocity),
+      ballBodyModel(nullptr) {
+    reset();
+}
+
+void Simulation::reset() {
+    ballPosition = launchPosition;
+    ballVelocity = Matrix4::rotationZ(launchAngle) * launchVelocity;
+    ballOrientation = initialBallOrientation;
+    ballAngularVelocity = initialBallAngularVelocity;
+
+    frameNumber = 0;
+    elapsedTime = 0.0f;
+    bounceCount = 0;
+    isInContact = false;
+    lastContactFrame = 0;
+    landingPosition = Cartesian3();
+    landingTime = 0.0f;
+
+    isFlightPlanned = false;
+    contactSolver.clear();
+    wake();
+}
+
+void Simulation::update() {
+    switch (integrator) {
+        case Integrator::VelocityVerlet:
+            step<VelocityVerlet>();
+            break;
+        case Integrator::RungeKutta4:
+            step<RungeKutta4>();
+            break;
+        default:
+            step<SemiImplicitEuler>();
+            break;
+    }
+}
+
+void Simulation::updateBallShape() {
+    if (ballBodyModel != ballModel) {
+        ballBody.setShape(*ballModel, 1.0f);
+        ballBodyModel = ballModel;
+    }
+}
+
+void Simulation::wake() {
+    isSleeping = false;
+    slowTime = 0.0f;
+    slowPosition = ballPosition;
+}
+
+template <typename Scheme>
+void Simulation::step() {
+    // a sleeping ball stays where it rests, still touching the terrain
+    if (isSleeping) {
+        frameNumber++;
+        elapsedTime += frameTime;
+        lastContactFrame = frameNumber;
+        isInContact = true;
+        return;
+    }
+
+    // an event-driven ball needs a new flight once the last one has ended
+    const bool flyEventDriven = isEventDriven();
+    if (flyEventDriven && (!isFlightPlanned || flightTerrain != terrain || elapsedTime >= flightEndTime)) {
+        planFlight();
+    } else if (!flyEventDriven) {
+        isFlightPlanned = false;
+    }
+
+    frameNumber++;
+    // a terrain paged in from disk reads the tiles ahead of the ball before it gets there
+    if (terrain != nullptr && frameNumber % prefetchFrames == 0) {
+        terrain->prefetch(ballPosition, ballVelocity, prefetchLookahead);
+    }
+    const float frameStartTime = elapsedTime;
+    elapsedTime += frameTime;
+
+    // time this update integrates: none while in flight, the rest of the frame once a flight ends in it
+    float stepTime = frameTime;
+    if (isFlightPlanned && flightEndTime > frameStartTime) {
+        const float flightTime = std::min(elapsedTime, flightEndTime);
+        sampleFlight(flightTime, ballPosition, ballVelocity);
+        stepTime = elapsedTime - flightTime;
+    }
+
+    // Gravity is a permanent force
+    ballVelocity = Scheme::kick(ballVelocity, gravity, stepTime);
+
+    // Off the edge of the terrain there is nothing to collide with
+    bool isColliding = false;
+    float approachSpeed = 0.0f;
+    // part of the frame still to move through once collisions are resolved
+    float remainingTime = stepTime;
+    if (stepTime > 0.0f && isOverTerrain()) {
+        // The rest depends on whether we have the sphere or the polyhedron.
+        // For simplicity, we will code it redundantly
+        const Terrain* meshTerrain = terrain->asTerrain();
+        if (useSphere && (continuousCollision || eventDriven) && meshTerrain != nullptr) {
+            // sweep the sphere along the frame's motion, stopping at each contact to bounce there
+            for (int contact = 0; contact < maxContactsPerFrame; contact++) {
+                const Cartesian3 end = ballPosition + ballVelocity * remainingTime;
+                float fraction;
+                Cartesian3 contactNormal;
+                if (!meshTerrain->sweepSphere(ballPosition, end, sphereRadius, fraction, contactNormal)) {
+                    break;
+                }
+                ballPosition = ballPosition + (end - ballPosition) * fraction;
+                remainingTime = contact + 1 < maxContactsPerFrame ? remainingTime * (1.0f - fraction) : 0.0f;
+                isColliding = true;
+                const float normalSpeed = ballVelocity.dot(contactNormal);
+                if (normalSpeed < 0.0f) {
+                    approachSpeed = std::max(approachSpeed, -normalSpeed);
+                    ballVelocity = ballVelocity - (1.0f + elasticity) * normalSpeed * contactNormal;
+                }
+            }
+        } else if (useSphere) {
+            // well above the terrain, the height pyramid rules a collision out without any lookup
+            if (terrain->maySweepHit(ballPosition, ballPosition + ballVelocity * frameTime, sphereRadius)) {
+                // if colliding against the terrain, apply bounce impulse instantaneously
+                float terrainHeight;
+                Cartesian3 terrainNormal;
+                terrain->getHeightAndNormal(ballPosition.x, ballPosition.y, terrainHeight, terrainNormal);
+                const float dz = ballPosition.z - terrainHeight;
+                isColliding = dz < sphereRadius || std::abs(dz) < std::numeric_limits<float>::epsilon();
+                if (isColliding) {
+                    approachSpeed = -ballVelocity.dot(terrainNormal);
+                    const Cartesian3 bounceImpulse = -(1.0f + elasticity) * ballVelocity.dot(terrainNormal) * terrainNormal;
+                    ballVelocity = ballVelocity + bounceImpulse;
+                    // Snap the sphere on top of the terrain to avoid penetration
+                    ballPosition.z = terrainHeight + sphereRadius;
+                }
+            }
+        } else if (meshTerrain != nullptr) {
+            // mass properties once per model, world inertia once per step
+            updateBallShape();
+            ballBody.setOrientation(ballOrientation);
+
+            // every contact with the terrain at once, friction included
+            contactSolver.findContacts(*meshTerrain, *ballModel, ballBody, ballPosition);
+            isColliding = contactSolver.contactCount() > 0;
+            if (isColliding) {
+                approachSpeed = contactSolver.solve(ballBody, ballVelocity, ballAngularVelocity, remainingTime);
+            }
+        }
+    }
+
+    if (!useSphere && ballModel != nullptr) {
+        // the ball turns about its centre of mass, which is what ballVelocity and the contact lever arms
+        // refer to, so the model origin at ballPosition swings around it
+        updateBallShape();
+        const Cartesian3 centreOfMass = ballPosition + ballOrientation.asMatrix().asMatrix3() * ballBody.centreOfMass;
+        ballOrientation = Scheme::rotate(ballOrientation, ballAngularVelocity, frameTime);
+        ballPosition = centreOfMass - ballOrientation.asMatrix().asMatrix3() * ballBody.centreOfMass;
+    }
+
+    // A new bounce starts whenever the ball hits the terrain hard enough
+    if (isColliding) {
+        if (approachSpeed > bounceSpeedThreshold) {
+            if (bounceCount == 0) {
+                landingPosition = ballPosition;
+                landingTime = elapsedTime;
+            }
+            bounceCount++;
+        }
+        lastContactFrame = frameNumber;
+    }
+    // a resting ball alternates between touching and hovering just above the terrain
+    isInContact = lastContactFrame > 0 && frameNumber - lastContactFrame <= contactFrameTolerance;
+
+    // After calculating velocity, update position with it
+    ballPosition = Scheme::drift(ballPosition, ballVelocity, gravity, remainingTime);
+
+    // a ball that has stayed in one place long enough is resting on the terrain for good
+    const bool isSlow = (ballPosition - slowPosition).length() < sleepSpeed * sleepDelay &&
+                        ballAngularVelocity.length() < sleepSpeed;
+    if (isSlow) {
+        slowTime += frameTime;
+    } else {
+        slowTime = 0.0f;
+        slowPosition = ballPosition;
+    }
+    if (slowTime > sleepDelay) {
+        isSleeping = true;
+        ballVelocity = Cartesian3();
+        ballAngularVelocity = Cartesian3();
+        isFlightPlanned = false;
+    }
+}
+
+SimulationOutcome Simulation::run(const unsigned long maxFrames, const float restSpeedThreshold) {
+    switch (integrator) {
+        case Integrator::VelocityVerlet:
+            return runFrames<VelocityVerlet>(maxFrames, restSpeedThreshold);
+        case Integrator::RungeKutta4:
+            return runFrames<RungeKutta4>(maxFrames, restSpeedThreshold);
+        default:
+            return runFrames<SemiImplicitEuler>(maxFrames, restSpeedThreshold);
+    }
+}
+
+template <typename Scheme>
+SimulationOutcome Simulation::runFrames(const unsigned long maxFrames, const float restSpeedThreshold) {
+    for (unsigned long frame = 0; frame < maxFrames; frame++) {
+        // in event-driven flight, the frames before the next contact need no work at all
+        frame += skipFlightFrames(maxFrames - frame - 1);
+        step<Scheme>();
+        if (!isOverTerrain()) {
+            return SimulationOutcome::OffTerrain;
+        }
+        if (isAtRest(restSpeedThreshold)) {
+            return SimulationOutcome::AtRest;
+        }
+    }
+    return SimulationOutcome::Running;
+}
+
+bool Simulation::isOverTerrain() const {
+    return terrain != nullptr && terrain->contains(ballPosition.x, ballPosition.y);
+}
+
+bool Simulation::isAtRest(const float speedThreshold) const {
+    return isInContact &&
+           ballVelocity.length() < speedThreshold &&
+           ballAngularVelocity.length() < speedThreshold;
+}
+
+bool Simulation::sampleFlight(const float time, Cartesian3& position, Cartesian3& velocity) const {
+    if (!isFlightPlanned || time < flightStartTime || time > flightEndTime) {
+        return false;
+    }
+    const float flightTime = time - flightStartTime;
+    position = flightStartPosition + flightStartVelocity * flightTime + gravity * (0.5f * flightTime * flightTime);
+    velocity = flightStartVelocity + gravity * flightTime;
+    return true;
+}
+
+bool Simulation::isEventDriven() const {
+    return useSphere && eventDriven && terrain != nullptr && terrain->asTerrain() != nullptr;
+}
+
+// Planning costs a few discrete frames' worth of work, so it only pays for flights longer than that.
+// It is still done on every frame in contact: stepping those frames with continuous collision instead
+// was measured to be slower, since a bouncing or rolling ball spends most frames in short hops
+void Simulation::planFlight() {
+    isFlightPlanned = true;
+    flightTerrain = terrain;
+    flightStartTime = elapsedTime;
+    flightEndTime = elapsedTime;
+    flightStartPosition = ballPosition;
+    flightStartVelocity = ballVelocity;
+    if (!isOverTerrain()) {
+        return;
+    }
+
+    // the flight ends at the edge of the terrain at the latest; x and y move in straight lines
+    const Terrain* meshTerrain = terrain->asTerrain();
+    float minX, minY, maxX, maxY;
+    meshTerrain->getExtent(minX, minY, maxX, maxY);
+    float horizon = maxFlightTime;
+    if (ballVelocity.x != 0.0f) {
+        horizon = std::min(horizon, ((ballVelocity.x > 0.0f ? maxX : minX) - ballPosition.x) / ballVelocity.x);
+    }
+    if (ballVelocity.y != 0.0f) {
+        horizon = std::min(horizon, ((ballVelocity.y > 0.0f ? maxY : minY) - ballPosition.y) / ballVelocity.y);
+    }
+
+    // March along the parabola in chords. Stretches the height pyramid rules out are skipped whole
+    // and the next one doubles; near the terrain chords halve until they are within flightTolerance
+    // of the arc, and are then swept exactly
+    const float gravityLength = gravity.length();
+    float time = 0.0f;
+    float step = frameTime;
+    Cartesian3 start = ballPosition;
+    while (time < horizon) {
+        const float nextTime = std::min(time + step, horizon);
+        const Cartesian3 end = ballPosition + ballVelocity * nextTime + gravity * (0.5f * nextTime * nextTime);
+        // the arc bulges below its chord by at most this much
+        const float sag = gravityLength * (nextTime - time) * (nextTime - time) / 8.0f;
+        if (!meshTerrain->maySweepHit(start, end, sphereRadius + sag)) {
+            time = nextTime;
+            start = end;
+            step *= 2.0f;
+            continue;
+        }
+        if (sag > flightTolerance) {
+            step *= 0.5f;
+            continue;
+        }
+        float fraction;
+        Cartesian3 contactNormal;
+        if (meshTerrain->sweepSphere(start, end, sphereRadius, fraction, contactNormal)) {
+            flightEndTime = elapsedTime + time + fraction * (nextTime - time);
+            return;
+        }
+        time = nextTime;
+        start = end;
+    }
+    flightEndTime = elapsedTime + horizon;
+}
+
+unsigned long Simulation::skipFlightFrames(const unsigned long maxFrames) {
+    if (!isEventDriven() || isSleeping) {
+        return 0;
+    }
+    if (!isFlightPlanned || flightTerrain != terrain || elapsedTime >= flightEndTime) {
+        planFlight();
+    }
+
+    // whole frames that end before the flight does; update() samples the ball after them
+    const float flightLeft = flightEndTime - elapsedTime;
+    const unsigned long frames = std::min(maxFrames, static_cast<unsigned long>(flightLeft / frameTime));
+    if (frames > 0) {
+        frameNumber += frames;
+        elapsedTime += frames * frameTime;
+        sampleFlight(std::min(elapsedTime, flightEndTime), ballPosition, ballVelocity);
+    }
+    return frames;
+}
@@ -0,0 +1,145 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "ContactSolver.h"
+#include "HeightField.h"
+#include "IndexedFaceSurface.h"
+#include "Integrators.h"
+#include "Quaternion.h"
+#include "RigidBody.h"
+
+// why run() stopped advancing the simulation
+enum class SimulationOutcome {
+    // frame budget exhausted while the ball was still moving
+    Running,
+    // ball touching the terrain and slower than the rest threshold
+    AtRest,
+    // ball left the terrain grid
+    OffTerrain
+};
+
+// short lower case name of an outcome, for reports
+const char* simulationOutcomeName(SimulationOutcome outcome);
+
+// Ball physics without any rendering or windowing dependencies.
+// Used by the interactive Scene and by the headless batch tools.
+class Simulation {
+public:
+    // The simulation does not own the terrain or the ball model.
+    // Continuous collision, event-driven flight and polyhedra need the triangles of an in-memory Terrain
+    // (terrain->asTerrain()); over any other HeightField, such as a PagedTerrain, spheres are always tested
+    // once per frame and polyhedra do not collide
+    const HeightField* terrain;
+    const IndexedFaceSurface* ballModel;
+
+    // true -> ball is a sphere of radius sphereRadius, false -> ball is the polyhedron ballModel
+    bool useSphere;
+
+    // Spheres only: true -> sweep the sphere through each frame and bounce at the exact time of impact,
+    // false -> test for overlap once per frame and snap the sphere out of the terrain
+    bool continuousCollision;
+
+    // Spheres only: true -> between contacts the ball follows its exact parabola, solved ahead against
+    // the terrain, so frames in flight are sampled in closed form and run() jumps straight to the next
+    // contact; frames in contact step with continuous collision
+    bool eventDriven;
+
+    // scheme moving the ball between bounce impulses, see Integrators.h
+    Integrator integrator;
+
+    // fixed time step applied by every update(), in seconds
+    float frameTime;
+
+    // launch parameters, applied on reset()
+    // angle of launch of ball (rotation around Z, in degrees)
+    float launchAngle;
+    Cartesian3 launchPosition;
+    Cartesian3 launchVelocity;
+
+    // ball properties
+    // position of the model origin; a polyhedron turns about its centre of mass, not about this point
+    Cartesian3 ballPosition;
+    // it is assumed mass = 1 => velocity is effectively linear momentum
+    Cartesian3 ballVelocity;
+    Quaternion ballOrientation;
+    Cartesian3 ballAngularVelocity;
+
+    // bookkeeping since the last reset()
+    unsigned long frameNumber;
+    float elapsedTime;
+    // number of separate contacts with the terrain
+    unsigned long bounceCount;
+    // true if the ball touched the terrain during the last few updates
+    bool isInContact;
+    unsigned long lastContactFrame;
+    // where and when the ball first touched the terrain, valid if bounceCount > 0
+    Cartesian3 landingPosition;
+    float landingTime;
+    // true once the ball has rested on the terrain for sleepDelay: updates then only advance the clock
+    bool isSleeping;
+    // how long the ball has stayed within sleepSpeed * sleepDelay of slowPosition
+    float slowTime;
+    Cartesian3 slowPosition;
+
+    Simulation();
+
+    // restore the ball to its launch state
+    void reset();
+
+    // advance the simulation by frameTime
+    void update();
+
+    // step a sleeping ball again, e.g. after moving it or the terrain under it
+    void wake();
+
+    // advance up to maxFrames updates, stopping early once the ball rests or leaves the terrain
+    SimulationOutcome run(unsigned long maxFrames, float restSpeedThreshold);
+
+    // true if the ball is above the terrain grid
+    bool isOverTerrain() const;
+
+    // true if the ball is touching the terrain and moving slower than speedThreshold
+    bool isAtRest(float speedThreshold) const;
+
+    // ball state at any time of the current event-driven flight, e.g. to render between updates
+    // false if no flight is under way at that time
+    bool sampleFlight(float time, Cartesian3& position, Cartesian3& velocity) const;
+
+private:
+    // mass properties of ballModel, recomputed only when the model changes
+    RigidBody ballBody;
+    const IndexedFaceSurface* ballBodyModel;
+    // polyhedra: contacts with the terrain and their impulses, kept from step to step
+    ContactSolver contactSolver;
+
+    // ballBody from ballModel, if the model has changed since the last call
+    void updateBallShape();
+
+    // update() and run() with the integrator fixed at compile time
+    template <typename Scheme>
+    void step();
+
+    template <typename Scheme>
+    SimulationOutcome runFrames(unsigned long maxFrames, float restSpeedThreshold);
+
+    // the flight the ball is on in event-driven mode, from its last contact to the next one
+    // or to the edge of the terrain
+    bool isFlightPlanned;
+    const HeightField* flightTerrain;
+    float flightStartTime;
+    float flightEndTime;
+    Cartesian3 flightStartPosition;
+    Cartesian3 flightStartVelocity;
+
+    // solve the parabola from the current state against the terrain, leaving no flight if the ball
+    // is already in contact
+    void planFlight();
+
+    // true if the ball flies event-driven, i.e. it is a sphere, eventDriven is set and the terrain is a Terrain
+    bool isEventDriven() const;
+
+    // whole frames left in the current flight, at most maxFrames, skipped in one go
+    unsigned long skipFlightFrames(unsigned long maxFrames);
+};
+
+#endif
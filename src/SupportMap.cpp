@@ -0,0 +1,111 @@
+#include "SupportMap.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+void SupportMap::build(const IndexedFaceSurface& surface) {
+    vertices.clear();
+    firstNeighbour.clear();
+    neighbours.clear();
+    extremes.clear();
+
+    // weld: sort the vertices by position and give every run of equal ones the same index
+    const int vertexCount = static_cast<int>(surface.vertices.size());
+    std::vector<int> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0);
+    const auto byPosition = [&](const int first, const int second) {
+        const Cartesian3& a = surface.vertices[first];
+        const Cartesian3& b = surface.vertices[second];
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    };
+    std::sort(order.begin(), order.end(), byPosition);
+    std::vector<int> welded(vertexCount);
+    for (int sorted = 0; sorted < vertexCount; sorted++) {
+        if (sorted == 0 || byPosition(order[sorted - 1], order[sorted])) {
+            vertices.push_back(surface.vertices[order[sorted]]);
+        }
+        welded[order[sorted]] = static_cast<int>(vertices.size()) - 1;
+    }
+
+    // every face edge, both ways, as (vertex, neighbour) pairs
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(surface.faceVertices.size() * 2);
+    for (size_t face = 0; face + 2 < surface.faceVertices.size(); face += 3) {
+        for (int corner = 0; corner < 3; corner++) {
+            const int from = welded[surface.faceVertices[face + corner]];
+            const int to = welded[surface.faceVertices[face + (corner + 1) % 3]];
+            if (from != to) {
+                edges.emplace_back(from, to);
+                edges.emplace_back(to, from);
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    firstNeighbour.assign(vertices.size() + 1, 0);
+    neighbours.reserve(edges.size());
+    for (const auto& [from, to] : edges) {
+        firstNeighbour[from + 1]++;
+        neighbours.push_back(to);
+    }
+    std::partial_sum(firstNeighbour.begin(), firstNeighbour.end(), firstNeighbour.begin());
+
+    if (vertices.empty()) {
+        return;
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        const auto byAxis = [axis](const Cartesian3& a, const Cartesian3& b) { return a[axis] < b[axis]; };
+        const auto [lowest, highest] = std::minmax_element(vertices.begin(), vertices.end(), byAxis);
+        extremes.push_back(static_cast<int>(lowest - vertices.begin()));
+        extremes.push_back(static_cast<int>(highest - vertices.begin()));
+    }
+}
+
+int SupportMap::support(const Cartesian3& direction, const int hint) const {
+    int current = hint;
+    if (current < 0 || current >= static_cast<int>(vertices.size())) {
+        current = extremes[0];
+        for (const int extreme : extremes) {
+            if (vertices[extreme].dot(direction) > vertices[current].dot(direction)) {
+                current = extreme;
+            }
+        }
+    }
+
+    // steepest ascent: move to the best neighbour until none is farther along direction
+    float currentDistance = vertices[current].dot(direction);
+    for (;;) {
+        int best = current;
+        for (int edge = firstNeighbour[current]; edge < firstNeighbour[current + 1]; edge++) {
+            const float distance = vertices[neighbours[edge]].dot(direction);
+            if (distance > currentDistance) {
+                currentDistance = distance;
+                best = neighbours[edge];
+            }
+        }
+        if (best == current) {
+            return current;
+        }
+        current = best;
+    }
+}
+
+void SupportMap::findCap(const Cartesian3& direction, const int start, const float tolerance,
+                         std::vector<int>& cap) const {
+    const float lowest = vertices[start].dot(direction) - tolerance;
+    const size_t first = cap.size();
+    cap.push_back(start);
+    // flood over the edges, the cap being small enough to look found vertices up linearly
+    for (size_t next = first; next < cap.size(); next++) {
+        const int current = cap[next];
+        for (int edge = firstNeighbour[current]; edge < firstNeighbour[current + 1]; edge++) {
+            const int neighbour = neighbours[edge];
+            if (vertices[neighbour].dot(direction) >= lowest &&
+                std::find(cap.begin() + first, cap.end(), neighbour) == cap.end()) {
+                cap.push_back(neighbour);
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef SUPPORT_MAP_H
+#define SUPPORT_MAP_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+#include "IndexedFaceSurface.h"
+
+// Vertices of a convex surface with the edges between them, for finding the vertex farthest along
+// any direction (the support point) by hill climbing instead of testing every vertex.
+// On a convex surface every local maximum is global, so the climb stops at the right vertex;
+// started from the previous answer it usually takes only a step or two.
+class SupportMap {
+public:
+    // rebuild the vertex graph, welding vertices at the same position so seams do not cut it
+    void build(const IndexedFaceSurface& surface);
+
+    bool empty() const { return vertices.empty(); }
+
+    // Index of a vertex farthest along direction, climbing from hint if it is a valid index
+    // or else from the best of the six axis extremes. Not valid on an empty map
+    int support(const Cartesian3& direction, int hint) const;
+
+    // Append the vertices within tolerance of the farthest along direction, e.g. the face a body rests on.
+    // start must be a support vertex for direction; on a convex surface the rest are connected to it
+    void findCap(const Cartesian3& direction, int start, float tolerance, std::vector<int>& cap) const;
+
+    const Cartesian3& vertex(const int index) const { return vertices[index]; }
+
+private:
+    std::vector<Cartesian3> vertices;
+    // neighbours of vertex v are neighbours[firstNeighbour[v]] up to neighbours[firstNeighbour[v + 1]]
+    std::vector<int> firstNeighbour;
+    std::vector<int> neighbours;
+    // vertices with the lowest and highest x, y and z, as starting points
+    std::vector<int> extremes;
+};
+
+#endif
@@ -1,196 +1,848 @@
 #include "Terrain.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <string>
 
-Terrain::Terrain(): xyScale(1) {
+#include "BinaryIO.h"
+#include "Geometry.h"
+#include "MappedFile.h"
+#include "Simd.h"
+#include "TextParsing.h"
+
+constexpr std::uint32_t terrainFileVersion = 1;
+
+// the batched queries gather normals as a flat array of floats
+static_assert(sizeof(Cartesian3) == 3 * sizeof(float), "normals must be tightly packed");
+
+Terrain::Terrain(): xyScale(1), heightfieldOnly(false) {
+}
+
+void Terrain::setHeightLayout(const HeightGridLayout layout) {
+    heightValues.setLayout(layout);
+}
+
+void Terrain::setHeightEncoding(const HeightGridEncoding encoding) {
+    heightValues.setEncoding(encoding);
+}
+
+void Terrain::setHeightfieldOnly(const bool heightfieldOnly) {
+    this->heightfieldOnly = heightfieldOnly;
 }
 
 bool Terrain::readTerrainFile(const char* fileName, float xyScale) {
-    std::ifstream inFile(fileName);
-    if (inFile.bad()) {
+    if (hasFileExtension(fileName, ".demb")) {
+        return readBinaryTerrainFile(fileName, xyScale);
+    }
+
+    if (!readHeightValues(fileName)) {
         return false;
     }
 
     // save the xy scale
     this->xyScale = xyScale;
 
+    buildSurface();
+    if (!heightfieldOnly) {
+        computeUnitNormalVectors();
+    }
+    heightBounds.build(heightValues);
+
+    return true;
+}
+
+bool Terrain::readHeightValues(const char* fileName) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        reportParseError(fileName, 0, "unable to open file");
+        return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(file.data());
+    const char* end = begin + file.size();
+
+    TextCursor cursor(begin, end, 1);
     long height = 0, width = 0;
-    inFile >> height >> width;
+    if (!cursor.readLong(height) || !cursor.readLong(width) || height < 2 || width < 2) {
+        reportParseError(fileName, cursor.line, "expected the number of rows and columns, at least 2 each");
+        return false;
+    }
+    const size_t nValues = static_cast<size_t>(height) * width;
+
+    // Split the values into line ranges. With more than one range, a first pass counts the values
+    // and lines in each, so that every range knows which height and line number it starts at
+    const std::vector<const char*> boundaries = splitAtLines(cursor.position, end, textPartCount(end - cursor.position));
+    const size_t nParts = boundaries.size() - 1;
+    std::vector<size_t> firstValue(nParts + 1, 0);
+    std::vector<long> firstLine(nParts + 1, cursor.line);
+    if (nParts > 1) {
+        std::vector<size_t> partValues(nParts);
+        std::vector<long> partLines(nParts);
+        forEachTextPart(end - cursor.position, nParts, [&](const size_t part) {
+            countTokensAndLines(boundaries[part], boundaries[part + 1], partValues[part], partLines[part]);
+        });
+        for (size_t part = 0; part < nParts; part++) {
+            firstValue[part + 1] = firstValue[part] + partValues[part];
+            firstLine[part + 1] = firstLine[part] + partLines[part];
+        }
+    } else {
+        firstValue[1] = nValues;
+    }
+    if (firstValue[nParts] < nValues) {
+        reportParseError(fileName, firstLine[nParts], "file ends after " + std::to_string(firstValue[nParts]) +
+                                                      " of " + std::to_string(nValues) + " height values");
+        return false;
+    }
 
-    // Per row height values
-    heightValues.resize(height);
-    for (int row = 0; row < height; row++) {
-        heightValues[row].resize(width);
+    // parse straight into row-major order, then reorder to the chosen layout and encoding.
+    // The terrain keeps its current heights until the whole file has parsed
+    HeightGrid grid;
+    grid.resize(height, width, HeightGridLayout::RowMajor);
+    float* values = grid.data();
+
+    std::vector<std::string> partErrors(nParts);
+    std::vector<long> partErrorLines(nParts, 0);
+    forEachTextPart(end - cursor.position, nParts, [&](const size_t part) {
+        TextCursor partCursor(boundaries[part], boundaries[part + 1], firstLine[part]);
+        const size_t lastValue = std::min(nValues, firstValue[part + 1]);
+        for (size_t value = firstValue[part]; value < lastValue; value++) {
+            if (!partCursor.readFloat(values[value])) {
+                partErrorLines[part] = partCursor.line;
+                partErrors[part] = partCursor.atEnd()
+                                       ? "file ends after " + std::to_string(value) + " of " +
+                                         std::to_string(nValues) + " height values"
+                                       : "malformed height value " + std::to_string(value);
+                return;
+            }
+        }
+    });
 
-        for (int col = 0; col < width; col++) {
-            inFile >> heightValues[row][col];
+    // report the first error in file order
+    for (size_t part = 0; part < nParts; part++) {
+        if (!partErrors[part].empty()) {
+            reportParseError(fileName, partErrorLines[part], partErrors[part]);
+            return false;
         }
     }
 
-    // We want the triangles to be centred at the origin,
-    // with the zero elevation set at 0 z, so we have to juggle things somewhat
-    // compute a temporary midpoint for the data so that it will end up centered at the origin
-    Cartesian3 midPoint{
-        midPoint.x = xyScale * (width / 2),
-        midPoint.y = xyScale * (height / 2),
-        midPoint.z = 0.0
-    };
+    grid.setLayout(heightValues.layout());
+    grid.setEncoding(heightValues.encoding());
+    heightValues = std::move(grid);
 
-    // each square of data is two triangles, but the end values don't have squares,
-    // so we don't need quite as many vertices
-    int nValues = height * width;
-    int nTriangles = (height - 1) * (width - 1) * 2;
-    vertices.resize(nValues);
-    faceVertices.resize(3 * nTriangles);
+    return true;
+}
 
-    // Load vertices
-    int vertex = 0;
-    for (int row = 0; row < height; row++) {
-        for (int col = 0; col < width; col++) {
-            vertices[vertex++] = Cartesian3(xyScale * col - midPoint.x,
-                                            midPoint.y - xyScale * row,
-                                            heightValues[row][col]);
-        }
+bool Terrain::readBinaryTerrainFile(const char* fileName, float xyScale) {
+    MappedFile file;
+    if (!file.open(fileName) || file.size() < sizeof(TerrainFileHeader)) {
+        return false;
     }
 
-    // Create 2 faces from square
-    int faceVertex = 0;
-    for (int row = 0; row < height - 1; row++) {
-        for (int col = 0; col < width - 1; col++) {
-            int baseIndex = row * width + col;
-            // first (UR) triangle
-            faceVertices[faceVertex++] = baseIndex;
-            faceVertices[faceVertex++] = baseIndex + width + 1;
-            faceVertices[faceVertex++] = baseIndex + 1;
+    TerrainFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "DEMB", 4) != 0 || header.version != terrainFileVersion ||
+        header.rows < 2 || header.columns < 2) {
+        return false;
+    }
 
-            // second (LL) triangle
-            faceVertices[faceVertex++] = baseIndex;
-            faceVertices[faceVertex++] = baseIndex + width;
-            faceVertices[faceVertex++] = baseIndex + width + 1;
-        }
+    const std::uint64_t nValues = static_cast<std::uint64_t>(header.rows) * header.columns;
+    const std::uint64_t nTriangles = static_cast<std::uint64_t>(header.rows - 1) * (header.columns - 1) * 2;
+    if (header.heightsOffset + nValues * sizeof(float) > file.size()) {
+        return false;
     }
+    const bool hasNormals = (header.flags & terrainFileHasNormals) != 0;
+    if (hasNormals && header.normalsOffset + nTriangles * sizeof(Cartesian3) > file.size()) {
+        return false;
+    }
+
+    // save the xy scale
+    this->xyScale = xyScale;
 
-    computeUnitNormalVectors();
+    // heights straight out of the mapping, in one copy if the layout is row-major
+    const HeightGridLayout layout = heightValues.layout();
+    const HeightGridEncoding encoding = heightValues.encoding();
+    heightValues.resize(header.rows, header.columns, HeightGridLayout::RowMajor);
+    std::memcpy(heightValues.data(), file.data() + header.heightsOffset, nValues * sizeof(float));
+    heightValues.setLayout(layout);
+    heightValues.setEncoding(encoding);
+
+    buildSurface();
+
+    // normals depend on the x-y spacing, so they are only reusable at the same scale
+    if (heightfieldOnly) {
+        normals.clear();
+    } else if (hasNormals && header.xyScale == xyScale) {
+        normals.resize(nTriangles);
+        std::memcpy(normals.data(), file.data() + header.normalsOffset, nTriangles * sizeof(Cartesian3));
+    } else {
+        computeUnitNormalVectors();
+    }
+    heightBounds.build(heightValues);
 
     return true;
 }
 
-float Terrain::getHeight(float x, float y) const {
-    float height = 0.0f;
+bool Terrain::writeBinaryTerrainFile(const char* fileName, const bool includeNormals) const {
+    if (heightValues.rows() < 2) {
+        return false;
+    }
+
+    std::ofstream outFile(fileName, std::ios::binary);
+    if (!outFile) {
+        return false;
+    }
 
-    const long nRows = heightValues.size();
-    const long nColumns = heightValues[0].size();
+    TerrainFileHeader header{};
+    std::memcpy(header.magic, "DEMB", 4);
+    header.version = terrainFileVersion;
+    header.rows = heightValues.rows();
+    header.columns = heightValues.columns();
+    header.flags = includeNormals ? terrainFileHasNormals : 0;
+    header.xyScale = xyScale;
+    header.heightsOffset = alignFileOffset(sizeof(header));
+    const std::uint64_t heightsSize = static_cast<std::uint64_t>(header.rows) * header.columns * sizeof(float);
+    header.normalsOffset = includeNormals ? alignFileOffset(header.heightsOffset + heightsSize) : 0;
+
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    padToFileOffset(outFile, header.heightsOffset);
+    std::vector<float> rowValues(header.columns);
+    for (long row = 0; row < heightValues.rows(); row++) {
+        heightValues.getRow(row, rowValues.data());
+        outFile.write(reinterpret_cast<const char*>(rowValues.data()), rowValues.size() * sizeof(float));
+    }
+    if (includeNormals) {
+        padToFileOffset(outFile, header.normalsOffset);
+        if (!normals.empty()) {
+            outFile.write(reinterpret_cast<const char*>(normals.data()), normals.size() * sizeof(Cartesian3));
+        } else {
+            // a row of squares at a time, for a heightfield-only terrain
+            std::vector<Cartesian3> rowNormals(2 * (header.columns - 1));
+            for (size_t firstFace = 0; firstFace < faceCount(); firstFace += rowNormals.size()) {
+                for (size_t face = 0; face < rowNormals.size(); face++) {
+                    rowNormals[face] = faceNormal(firstFace + face);
+                }
+                outFile.write(reinterpret_cast<const char*>(rowNormals.data()), rowNormals.size() * sizeof(Cartesian3));
+            }
+        }
+    }
 
-    const long totalHeight = (nRows - 1) * xyScale;
+    return static_cast<bool>(outFile);
+}
 
-    // (0,0) is at the dead centre given the layout of the data
-    // It is located at x = nRows / 2 (integer), y = nRows / 2 (integer)
-    const long i = nRows / 2;
-    const long j = nColumns / 2;
+GridCell Terrain::findCell(const float x, const float y) const {
+    return findGridCell(x, y, heightValues.rows(), heightValues.columns(), xyScale);
+}
 
-    // correct x and y for this offset (note rows are y, columns are x)
-    x = x + j * xyScale;
-    y = y + i * xyScale;
+float Terrain::cellHeight(const GridCell& cell) const {
+    return squareHeight(heightValues.square(cell.row, cell.column), cell.xRemainder, cell.yRemainder);
+}
 
-    // we need to flip coordinates vertically because the rows start at the top
-    y = totalHeight - y;
+size_t Terrain::cellFace(const GridCell& cell) const {
+    // once we have the row and column, we can work out the ID of the square the point is in
+    const size_t squareID = cell.row * (heightValues.columns() - 1) + cell.column;
 
-    // now divide by the x-y scale to get the index
-    const long xInteger = x / xyScale;
-    const long yInteger = y / xyScale;
+    // the LL triangle, below the TL-BR diagonal, is the second triangle in the square
+    return 2 * squareID + (cell.xRemainder < cell.yRemainder ? 1 : 0);
+}
 
-    // work out the fractional parts
-    const float xRemainder = (x - xyScale * xInteger) / xyScale;
-    const float yRemainder = (y - xyScale * yInteger) / xyScale;
+float Terrain::getHeight(const float x, const float y) const {
+    return cellHeight(findCell(x, y));
+}
 
-    // find the row and column
-    const long row = yInteger;
-    const long column = xInteger;
+Cartesian3 Terrain::getNormal(const float x, const float y) const {
+    return faceNormal(cellFace(findCell(x, y)));
+}
 
-    // OK. There are two possibilities - above or below the TL-BR diagonal
-    // Since this is the line x = y, it's easy to check
-    if (xRemainder < yRemainder) {
-        // LL triangle
-        // in theory, we want barycentric interpolation, but fortunately, it collapses for us because we have
-        // right triangles.
-        // y_remainder is alpha, the barycentric coordinate for the UL corner
-        // (1.0 - y_remainder) * x_remainder is beta, the barycentric coordinate for the LR corner
-        // (1.0 - y_remainder) * (1.0 - x_remainder) is gamma, the barycentric coordinate for the LL corner
-        const float alpha = yRemainder;
-        const float beta = (1.0 - yRemainder) * xRemainder;
-        const float gamma = 1.0 - alpha - beta;
-
-        // compute and return
-        height = alpha * heightValues[row][column] +
-                 beta * heightValues[row + 1][column + 1] +
-                 gamma * heightValues[row + 1][column];
-    } else {
+void Terrain::getHeightAndNormal(const float x, const float y, float& height, Cartesian3& normal) const {
+    const GridCell cell = findCell(x, y);
+    height = cellHeight(cell);
+    normal = faceNormal(cellFace(cell));
+}
+
+void Terrain::getHeights(const float* x, const float* y, const size_t count, float* heights) const {
+    queryPoints(x, y, count, heights, nullptr, nullptr, nullptr);
+}
+
+void Terrain::getNormals(const float* x, const float* y, const size_t count,
+                         float* normalX, float* normalY, float* normalZ) const {
+    queryPoints(x, y, count, nullptr, normalX, normalY, normalZ);
+}
+
+void Terrain::getHeightsAndNormals(const float* x, const float* y, const size_t count, float* heights,
+                                   float* normalX, float* normalY, float* normalZ) const {
+    queryPoints(x, y, count, heights, normalX, normalY, normalZ);
+}
+
+void Terrain::queryPoints(const float* x, const float* y, const size_t count, float* heights,
+                          float* normalX, float* normalY, float* normalZ) const {
+    // nothing to look up before a terrain is read
+    if (heightValues.rows() < 2) {
+        return;
+    }
+    const bool wantsNormals = normalX != nullptr;
+    size_t point = 0;
+
+#ifdef SIMD_HAS_GATHER
+    // the same arithmetic as findCell, cellHeight and cellFace, one lane per point
+    const long nRows = heightValues.rows();
+    const long nColumns = heightValues.columns();
+    const SimdFloat scale(xyScale);
+    const SimdFloat xOffset((nColumns / 2) * xyScale);
+    const SimdFloat yOffset((nRows / 2) * xyScale);
+    const SimdFloat totalHeight(static_cast<long>((nRows - 1) * xyScale));
+    const SimdFloat one(1.0f);
+    const SimdFloat zeroFloat(0.0f);
+    const SimdFloat maxX((nColumns - 1) * xyScale);
+    const SimdFloat maxY((nRows - 1) * xyScale);
+    const SimdInt zero(0);
+    const SimdInt lastRow(static_cast<int>(nRows - 2));
+    const SimdInt lastColumn(static_cast<int>(nColumns - 2));
+    const SimdInt squaresPerRow(static_cast<int>(nColumns - 1));
+    // null for a heightfield-only terrain
+    const float* normalData = normals.empty() ? nullptr : reinterpret_cast<const float*>(normals.data());
+
+    for (; point + SimdFloat::width <= count; point += SimdFloat::width) {
+        // max returns its second operand for NaN, which clamps NaN to 0 as clampToGrid does
+        const SimdFloat gridX = SimdFloat::min(SimdFloat::max(SimdFloat::load(x + point) + xOffset, zeroFloat), maxX);
+        const SimdFloat gridY = SimdFloat::min(SimdFloat::max(totalHeight - (SimdFloat::load(y + point) + yOffset),
+                                                              zeroFloat), maxY);
+        const SimdInt row = SimdInt::min(SimdInt::truncate(gridY / scale), lastRow);
+        const SimdInt column = SimdInt::min(SimdInt::truncate(gridX / scale), lastColumn);
+        const SimdFloat xRemainder = (gridX - scale * column.toFloat()) / scale;
+        const SimdFloat yRemainder = (gridY - scale * row.toFloat()) / scale;
+        const SimdMask isLowerLeft = xRemainder < yRemainder;
+
+        if (heights != nullptr) {
+            const SimdInt nextRow = row + SimdInt(1);
+            const SimdInt nextColumn = column + SimdInt(1);
+            const SimdFloat topLeft = heightValues.gather(row, column);
+            const SimdFloat bottomRight = heightValues.gather(nextRow, nextColumn);
+            // the third corner is bottom left for the LL triangle, top right for the UR one
+            const SimdFloat third = heightValues.gather(SimdInt::select(isLowerLeft, nextRow, row),
+                                                        SimdInt::select(isLowerLeft, column, nextColumn));
+
+            const SimdFloat alpha = SimdFloat::select(isLowerLeft, yRemainder, one - yRemainder);
+            const SimdFloat beta = SimdFloat::select(isLowerLeft, (one - yRemainder) * xRemainder,
+                                                     xRemainder * yRemainder);
+            const SimdFloat gamma = one - alpha - beta;
+            (alpha * topLeft + beta * bottomRight + gamma * third).store(heights + point);
+        }
+
+        if (wantsNormals && normalData != nullptr) {
+            const SimdInt face = (row * squaresPerRow + column) * SimdInt(2) +
+                                 SimdInt::select(isLowerLeft, SimdInt(1), zero);
+            const SimdInt first = face * SimdInt(3);
+            SimdFloat::gather(normalData, first).store(normalX + point);
+            SimdFloat::gather(normalData, first + SimdInt(1)).store(normalY + point);
+            SimdFloat::gather(normalData, first + SimdInt(2)).store(normalZ + point);
+        } else if (wantsNormals) {
+            // Without stored normals, the cross product of the triangle's edges, which for a grid
+            // triangle is (height differences along x and y, xyScale) up to length
+            const SimdInt nextRow = row + SimdInt(1);
+            const SimdInt nextColumn = column + SimdInt(1);
+            const SimdFloat topLeft = heightValues.gather(row, column);
+            const SimdFloat topRight = heightValues.gather(row, nextColumn);
+            const SimdFloat bottomLeft = heightValues.gather(nextRow, column);
+            const SimdFloat bottomRight = heightValues.gather(nextRow, nextColumn);
+            const SimdFloat slopeX = SimdFloat::select(isLowerLeft, bottomLeft - bottomRight, topLeft - topRight);
+            const SimdFloat slopeY = SimdFloat::select(isLowerLeft, bottomLeft - topLeft, bottomRight - topRight);
+            const SimdFloat inverseLength = one / SimdFloat::sqrt(slopeX * slopeX + slopeY * slopeY + scale * scale);
+            (slopeX * inverseLength).store(normalX + point);
+            (slopeY * inverseLength).store(normalY + point);
+            (scale * inverseLength).store(normalZ + point);
+        }
+    }
+#endif
+
+    // the tail, or every point without gathers
+    for (; point < count; point++) {
+        const GridCell cell = findCell(x[point], y[point]);
+        if (heights != nullptr) {
+            heights[point] = cellHeight(cell);
+        }
+        if (wantsNormals) {
+            const Cartesian3 normal = faceNormal(cellFace(cell));
+            normalX[point] = normal.x;
+            normalY[point] = normal.y;
+            normalZ[point] = normal.z;
+        }
+    }
+}
+
+bool Terrain::contains(const float x, const float y) const {
+    return gridContains(x, y, heightValues.rows(), heightValues.columns(), xyScale);
+}
+
+void Terrain::getExtent(float& minX, float& minY, float& maxX, float& maxY) const {
+    gridExtent(heightValues.rows(), heightValues.columns(), xyScale, minX, minY, maxX, maxY);
+}
+
+void Terrain::toGrid(const float x, const float y, float& column, float& row) const {
+    const long nRows = heightValues.rows();
+    const long nColumns = heightValues.columns();
+
+    // same offset and flip as getHeight
+    const float totalHeight = static_cast<long>((nRows - 1) * xyScale);
+    column = (x + (nColumns / 2) * xyScale) / xyScale;
+    row = (totalHeight - (y + (nRows / 2) * xyScale)) / xyScale;
+}
+
+Cartesian3 Terrain::gridVertex(const long row, const long column) const {
+    // centred on the middle row and column, at the same offsets findCell undoes
+    const float midPointX = xyScale * (heightValues.columns() / 2);
+    const float midPointY = xyScale * (heightValues.rows() / 2);
+    return Cartesian3(xyScale * column - midPointX, midPointY - xyScale * row, heightValues(row, column));
+}
+
+size_t Terrain::faceCount() const {
+    if (heightValues.rows() < 2) {
+        return 0;
+    }
+    return 2 * static_cast<size_t>(heightValues.rows() - 1) * (heightValues.columns() - 1);
+}
+
+void Terrain::faceCorners(const size_t face, Cartesian3 corners[3]) const {
+    const size_t square = face / 2;
+    const long row = square / (heightValues.columns() - 1);
+    const long column = square % (heightValues.columns() - 1);
+    corners[0] = gridVertex(row, column);
+    if (face % 2 == 0) {
         // UR triangle
-        // (1.0 - x_remainder) is alpha, the barycentric coordinate for the UL corner
-        // x_remainder * y_remainder is beta, the barycentric coordinate for the LR corner
-        // x_remainder * (1.0 - y_remainder) is gamma, the barycentric coordinate for the UR corner
-        const float alpha = 1.0 - yRemainder;
-        const float beta = xRemainder * yRemainder;
-        const float gamma = 1.0 - alpha - beta;
+        corners[1] = gridVertex(row + 1, column + 1);
+        corners[2] = gridVertex(row, column + 1);
+    } else {
+        // LL triangle
+        corners[1] = gridVertex(row + 1, column);
+        corners[2] = gridVertex(row + 1, column + 1);
+    }
+}
 
-        height = alpha * heightValues[row][column] +
-                 beta * heightValues[row + 1][column + 1] +
-                 gamma * heightValues[row][column + 1];
+Cartesian3 Terrain::faceNormal(const size_t face) const {
+    if (!normals.empty()) {
+        return normals[face];
+    }
+    // as computeUnitNormalVectors does it
+    Cartesian3 corners[3];
+    faceCorners(face, corners);
+    return (corners[1] - corners[0]).cross(corners[2] - corners[0]).unit();
+}
+
+bool Terrain::boxSquareRange(const float minX, const float minY, const float maxX, const float maxY,
+                             long& firstRow, long& firstColumn, long& lastRow, long& lastColumn) const {
+    const long nRows = heightValues.rows();
+    const long nColumns = heightValues.columns();
+
+    // same offset and flip as getHeight, on the corners of the box
+    const float totalHeight = static_cast<long>((nRows - 1) * xyScale);
+    const float left = minX + (nColumns / 2) * xyScale;
+    const float right = maxX + (nColumns / 2) * xyScale;
+    const float top = totalHeight - (maxY + (nRows / 2) * xyScale);
+    const float bottom = totalHeight - (minY + (nRows / 2) * xyScale);
+    // a NaN would pass through the clamps below and then convert to long
+    if (!(left <= right) || !(top <= bottom)) {
+        return false;
     }
 
-    return height;
+    // clamp while still in floating point, so huge coordinates cannot overflow
+    const float lastSquareRow = heightBounds.squareRows() - 1;
+    const float lastSquareColumn = heightBounds.squareColumns() - 1;
+    firstRow = std::clamp(std::floor(top / xyScale), 0.0f, lastSquareRow);
+    lastRow = std::clamp(std::floor(bottom / xyScale), 0.0f, lastSquareRow);
+    firstColumn = std::clamp(std::floor(left / xyScale), 0.0f, lastSquareColumn);
+    lastColumn = std::clamp(std::floor(right / xyScale), 0.0f, lastSquareColumn);
+    return true;
 }
 
-Cartesian3 Terrain::getNormal(float x, float y) const {
-    const long nRows = heightValues.size();
-    const long nColumns = heightValues[0].size();
+bool Terrain::mayReach(const float minX, const float minY, const float maxX, const float maxY,
+                       const float height) const {
+    if (heightBounds.empty()) {
+        return false;
+    }
+    long firstRow, firstColumn, lastRow, lastColumn;
+    if (!boxSquareRange(minX, minY, maxX, maxY, firstRow, firstColumn, lastRow, lastColumn)) {
+        return false;
+    }
+    return heightBounds.range(heightValues, firstRow, firstColumn, lastRow, lastColumn).maximum >= height;
+}
 
-    // Use this to compute the logical size of the map
-    const long totalHeight = (nRows - 1) * xyScale;
+void Terrain::findSweptSquares(const Cartesian3& start, const Cartesian3& end, const float radius,
+                               std::vector<long>& squares) const {
+    if (heightBounds.empty()) {
+        return;
+    }
+    long firstRow, firstColumn, lastRow, lastColumn;
+    if (!boxSquareRange(std::min(start.x, end.x) - radius, std::min(start.y, end.y) - radius,
+                        std::max(start.x, end.x) + radius, std::max(start.y, end.y) + radius,
+                        firstRow, firstColumn, lastRow, lastColumn)) {
+        return;
+    }
+    const float lowest = std::min(start.z, end.z) - radius;
+    heightBounds.findSquaresReaching(heightValues, firstRow, firstColumn, lastRow, lastColumn, lowest, squares);
+}
 
-    // this returns the height at a known point.
-    // we start by noting that (0,0) is in the dead centre, which is located at
-    // x = nRows / 2 (integer), y = nRows / 2 (integer)
-    const long i = nRows / 2;
-    const long j = nColumns / 2;
+// Earliest t in [0, bestT) at which a sphere of the given radius, centred at start + t * move,
+// touches the point at distance^2 = a t^2 + 2 b t + c from it, with c < 0 meaning it already does.
+static bool earliestRoot(const float a, const float b, const float c, float& bestT) {
+    if (c < 0.0f) {
+        // already overlapping: a contact now if closing in
+        if (b >= 0.0f) {
+            return false;
+        }
+        bestT = 0.0f;
+        return true;
+    }
+    const float discriminant = b * b - a * c;
+    if (a <= 0.0f || b >= 0.0f || discriminant < 0.0f) {
+        return false;
+    }
+    const float t = (-b - std::sqrt(discriminant)) / a;
+    if (t >= bestT) {
+        return false;
+    }
+    bestT = t;
+    return true;
+}
 
-    // now correct x and y for this offset (note rows are y, columns are x)
-    x = x + j * xyScale;
-    y = y + i * xyScale;
+// sphere sweep against a single vertex
+static bool sweepSphereVertex(const Cartesian3& start, const Cartesian3& move, const float radius,
+                              const Cartesian3& vertex, float& bestT, Cartesian3& contactNormal) {
+    const Cartesian3 offset = start - vertex;
+    if (!earliestRoot(move.dot(move), move.dot(offset), offset.dot(offset) - radius * radius, bestT)) {
+        return false;
+    }
+    contactNormal = (start + move * bestT - vertex).unit();
+    return true;
+}
 
-    // we need to flip coordinates vertically because the rows start at the top
-    y = totalHeight - y;
+// sphere sweep against the inside of one edge, as an infinite cylinder clipped to the edge
+static bool sweepSphereEdge(const Cartesian3& start, const Cartesian3& move, const float radius,
+                            const Cartesian3& from, const Cartesian3& to, float& bestT, Cartesian3& contactNormal) {
+    const Cartesian3 edge = to - from;
+    const Cartesian3 offset = start - from;
+    const float edgeEdge = edge.dot(edge);
+    const float edgeMove = edge.dot(move);
+    const float edgeOffset = edge.dot(offset);
+
+    // distances perpendicular to the edge, scaled by its squared length
+    float t = bestT;
+    if (!earliestRoot(edgeEdge * move.dot(move) - edgeMove * edgeMove,
+                      edgeEdge * move.dot(offset) - edgeOffset * edgeMove,
+                      edgeEdge * (offset.dot(offset) - radius * radius) - edgeOffset * edgeOffset, t)) {
+        return false;
+    }
+    const float along = (edgeOffset + t * edgeMove) / edgeEdge;
+    if (along < 0.0f || along > 1.0f) {
+        return false;
+    }
+    bestT = t;
+    contactNormal = (start + move * t - (from + edge * along)).unit();
+    return true;
+}
 
-    // now divide by the x-y scale to get the index
-    const long xInteger = x / xyScale;
-    const long yInteger = y / xyScale;
+// sphere sweep against one triangle with unit normal facing the sphere side
+static bool sweepSphereTriangle(const Cartesian3& start, const Cartesian3& move, const float radius,
+                                const Cartesian3 corners[3], const Cartesian3& normal,
+                                float& bestT, Cartesian3& contactNormal) {
+    // the face: reached when the centre is radius away from its plane, from the front
+    const float startDistance = (start - corners[0]).dot(normal);
+    if (startDistance < -radius) {
+        // already past it
+        return false;
+    }
+    const float moveDistance = move.dot(normal);
+    if (moveDistance < 0.0f) {
+        const float faceT = std::max(0.0f, (radius - startDistance) / moveDistance);
+        if (faceT >= bestT) {
+            return false;
+        }
+        const Cartesian3 touching = start + move * faceT - normal * radius;
+        bool isInside = true;
+        for (int corner = 0; corner < 3 && isInside; corner++) {
+            const Cartesian3& from = corners[corner];
+            const Cartesian3& to = corners[(corner + 1) % 3];
+            isInside = (to - from).cross(touching - from).dot(normal) >= 0.0f;
+        }
+        if (isInside) {
+            bestT = faceT;
+            contactNormal = normal;
+            return true;
+        }
+    }
 
-    // now work out the fractional parts
-    const float xRemainder = (x - xyScale * xInteger) / xyScale;
-    const float yRemainder = (y - xyScale * yInteger) / xyScale;
+    // otherwise the sphere can only meet the triangle on its border
+    bool isHit = false;
+    for (int corner = 0; corner < 3; corner++) {
+        isHit |= sweepSphereEdge(start, move, radius, corners[corner], corners[(corner + 1) % 3],
+                                 bestT, contactNormal);
+        isHit |= sweepSphereVertex(start, move, radius, corners[corner], bestT, contactNormal);
+    }
+    return isHit;
+}
 
-    // now we can find the row and column easily
-    const long row = yInteger;
-    const long column = xInteger;
+bool Terrain::sweepSphere(const Cartesian3& start, const Cartesian3& end, const float radius,
+                          float& fraction, Cartesian3& contactNormal) const {
+    // the terrain is shared between threads, so each keeps its own candidate list
+    thread_local std::vector<long> squares;
+    squares.clear();
+    findSweptSquares(start, end, radius, squares);
+
+    const Cartesian3 move = end - start;
+    float bestT = 1.0f;
+    bool isHit = false;
+    for (const long square : squares) {
+        for (long face = 2 * square; face < 2 * square + 2; face++) {
+            Cartesian3 corners[3];
+            faceCorners(face, corners);
+            isHit |= sweepSphereTriangle(start, move, radius, corners, faceNormal(face), bestT, contactNormal);
+        }
+    }
+    if (isHit) {
+        fraction = bestT;
+    }
+    return isHit;
+}
 
-    // once we have that, we can work out the ID of the square the point is in
-    const long squareID = row * (nColumns - 1) + column;
+bool Terrain::castRay(const Cartesian3& origin, const Cartesian3& direction, const float maxDistance,
+                      Cartesian3& hitPoint, Cartesian3& hitNormal, size_t& face) const {
+    if (heightBounds.empty()) {
+        return false;
+    }
+    const long squareRows = heightBounds.squareRows();
+    const long squareColumns = heightBounds.squareColumns();
+
+    // the ray in grid units, with rows counted downwards
+    float startColumn, startRow;
+    toGrid(origin.x, origin.y, startColumn, startRow);
+    const float columnRate = direction.x / xyScale;
+    const float rowRate = -direction.y / xyScale;
+
+    // clip the ray to the grid, one slab per axis
+    float enterT = 0.0f;
+    float exitT = maxDistance;
+    const auto clip = [&](const float start, const float rate, const float size) {
+        if (rate == 0.0f) {
+            return start >= 0.0f && start <= size;
+        }
+        const float first = -start / rate;
+        const float second = (size - start) / rate;
+        enterT = std::max(enterT, std::min(first, second));
+        exitT = std::min(exitT, std::max(first, second));
+        return enterT <= exitT;
+    };
+    if (!clip(startColumn, columnRate, squareColumns) || !clip(startRow, rowRate, squareRows)) {
+        return false;
+    }
 
-    // There are two possibilities - above or below the TL-BR diagonal
-    // Since this is the line x = y, it's easy to check
-    if (xRemainder < yRemainder) {
-        // LL triangle
-        // second triangle in the square
-        long faceID = 2 * squareID + 1;
+    // Walk the squares in the order the ray crosses them (Amanatides and Woo): nextColumnT and nextRowT
+    // are where it leaves the current square through a column or row boundary
+    constexpr float never = std::numeric_limits<float>::infinity();
+    long column = std::clamp(static_cast<long>(std::floor(startColumn + columnRate * enterT)), 0L, squareColumns - 1);
+    long row = std::clamp(static_cast<long>(std::floor(startRow + rowRate * enterT)), 0L, squareRows - 1);
+    const long columnStep = columnRate > 0.0f ? 1 : -1;
+    const long rowStep = rowRate > 0.0f ? 1 : -1;
+    const float columnDeltaT = columnRate != 0.0f ? std::abs(1.0f / columnRate) : never;
+    const float rowDeltaT = rowRate != 0.0f ? std::abs(1.0f / rowRate) : never;
+    float nextColumnT = columnRate != 0.0f ? (column + (columnRate > 0.0f ? 1 : 0) - startColumn) / columnRate : never;
+    float nextRowT = rowRate != 0.0f ? (row + (rowRate > 0.0f ? 1 : 0) - startRow) / rowRate : never;
+
+    float inT = enterT;
+    for (;;) {
+        const float outT = std::min({nextColumnT, nextRowT, exitT});
+
+        // only a square whose corners span the ray's height over it can hold a hit
+        const HeightSquare corners = heightValues.square(row, column);
+        const float lowest = std::min({corners.topLeft, corners.topRight, corners.bottomLeft, corners.bottomRight});
+        const float highest = std::max({corners.topLeft, corners.topRight, corners.bottomLeft, corners.bottomRight});
+        const float inZ = origin.z + direction.z * inT;
+        const float outZ = origin.z + direction.z * outT;
+        if (std::min(inZ, outZ) <= highest && std::max(inZ, outZ) >= lowest) {
+            // the triangles lie inside the square, so the nearer hit in it is the nearest of all
+            const size_t square = row * squareColumns + column;
+            float bestT = never;
+            for (size_t candidate = 2 * square; candidate < 2 * square + 2; candidate++) {
+                Cartesian3 triangle[3];
+                faceCorners(candidate, triangle);
+                float t;
+                if (intersectRayTriangle(origin, direction, triangle, t) && t >= 0.0f && t <= maxDistance &&
+                    t < bestT) {
+                    bestT = t;
+                    face = candidate;
+                }
+            }
+            if (bestT != never) {
+                hitPoint = origin + direction * bestT;
+                hitNormal = faceNormal(face);
+                return true;
+            }
+        }
 
-        // return its normal
-        return normals[faceID];
-    } else {
-        // UR triangle
-        // first triangle in the square
-        long faceID = 2 * squareID;
+        if (outT >= exitT) {
+            return false;
+        }
+        if (nextColumnT < nextRowT) {
+            column += columnStep;
+            nextColumnT += columnDeltaT;
+        } else {
+            row += rowStep;
+            nextRowT += rowDeltaT;
+        }
+        if (column < 0 || column >= squareColumns || row < 0 || row >= squareRows) {
+            return false;
+        }
+        inT = outT;
+    }
+}
+
+size_t Terrain::findFacesInBox(const float minX, const float minY, const float maxX, const float maxY,
+                               size_t* faces, const size_t capacity) const {
+    float extentMinX, extentMinY, extentMaxX, extentMaxY;
+    getExtent(extentMinX, extentMinY, extentMaxX, extentMaxY);
+    if (heightBounds.empty() || maxX < extentMinX || minX > extentMaxX || maxY < extentMinY || minY > extentMaxY) {
+        return 0;
+    }
+    long firstRow, firstColumn, lastRow, lastColumn;
+    if (!boxSquareRange(minX, minY, maxX, maxY, firstRow, firstColumn, lastRow, lastColumn)) {
+        return 0;
+    }
+    float left, top, right, bottom;
+    toGrid(minX, maxY, left, top);
+    toGrid(maxX, minY, right, bottom);
+
+    size_t found = 0;
+    for (long row = firstRow; row <= lastRow; row++) {
+        for (long column = firstColumn; column <= lastColumn; column++) {
+            // the part of the box over the square, from the square's top left corner in grid units
+            const float boxLeft = std::max(left - column, 0.0f);
+            const float boxRight = std::min(right - column, 1.0f);
+            const float boxTop = std::max(top - row, 0.0f);
+            const float boxBottom = std::min(bottom - row, 1.0f);
+            if (boxLeft > boxRight || boxTop > boxBottom) {
+                continue;
+            }
+            // the first (UR) triangle lies right of the TL-BR diagonal, the second (LL) one left of it
+            const size_t square = row * heightBounds.squareColumns() + column;
+            if (boxRight >= boxTop) {
+                if (found < capacity) {
+                    faces[found] = 2 * square;
+                }
+                found++;
+            }
+            if (boxLeft <= boxBottom) {
+                if (found < capacity) {
+                    faces[found] = 2 * square + 1;
+                }
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+// squared x-y distance from (x, y) to a triangle seen from above, zero over it
+static float flatDistanceSquared(const float x, const float y, const Cartesian3 corners[3]) {
+    bool hasNegative = false;
+    bool hasPositive = false;
+    float nearest = std::numeric_limits<float>::max();
+    for (int edge = 0; edge < 3; edge++) {
+        const Cartesian3& from = corners[edge];
+        const Cartesian3& to = corners[(edge + 1) % 3];
+        const float edgeX = to.x - from.x;
+        const float edgeY = to.y - from.y;
+        const float offsetX = x - from.x;
+        const float offsetY = y - from.y;
+        const float side = edgeX * offsetY - edgeY * offsetX;
+        hasNegative |= side < 0.0f;
+        hasPositive |= side > 0.0f;
+
+        const float along = std::clamp((offsetX * edgeX + offsetY * edgeY) / (edgeX * edgeX + edgeY * edgeY),
+                                       0.0f, 1.0f);
+        const float awayX = offsetX - along * edgeX;
+        const float awayY = offsetY - along * edgeY;
+        nearest = std::min(nearest, awayX * awayX + awayY * awayY);
+    }
+    return hasNegative && hasPositive ? nearest : 0.0f;
+}
+
+size_t Terrain::findFacesInCircle(const float centreX, const float centreY, const float radius,
+                                  size_t* faces, const size_t capacity) const {
+    float extentMinX, extentMinY, extentMaxX, extentMaxY;
+    getExtent(extentMinX, extentMinY, extentMaxX, extentMaxY);
+    if (heightBounds.empty() || radius < 0.0f ||
+        centreX + radius < extentMinX || centreX - radius > extentMaxX ||
+        centreY + radius < extentMinY || centreY - radius > extentMaxY) {
+        return 0;
+    }
+    long firstRow, firstColumn, lastRow, lastColumn;
+    if (!boxSquareRange(centreX - radius, centreY - radius, centreX + radius, centreY + radius,
+                        firstRow, firstColumn, lastRow, lastColumn)) {
+        return 0;
+    }
 
-        // return its normal
-        return normals[faceID];
+    size_t found = 0;
+    for (long row = firstRow; row <= lastRow; row++) {
+        for (long column = firstColumn; column <= lastColumn; column++) {
+            const size_t square = row * heightBounds.squareColumns() + column;
+            for (size_t face = 2 * square; face < 2 * square + 2; face++) {
+                Cartesian3 corners[3];
+                faceCorners(face, corners);
+                if (flatDistanceSquared(centreX, centreY, corners) <= radius * radius) {
+                    if (found < capacity) {
+                        faces[found] = face;
+                    }
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void Terrain::buildSurface() {
+    const long height = heightValues.rows();
+    const long width = heightValues.columns();
+
+    // a heightfield-only terrain generates all of it on demand
+    if (heightfieldOnly) {
+        vertices.clear();
+        vertices.shrink_to_fit();
+        faceVertices.clear();
+        faceVertices.shrink_to_fit();
+        normals.clear();
+        normals.shrink_to_fit();
+        return;
+    }
+
+    // each square of data is two triangles, but the end values don't have squares,
+    // so we don't need quite as many vertices
+    int nValues = height * width;
+    int nTriangles = (height - 1) * (width - 1) * 2;
+    vertices.resize(nValues);
+    faceVertices.resize(3 * nTriangles);
+
+    // Load vertices, centred at the origin in x-y
+    int vertex = 0;
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            vertices[vertex++] = gridVertex(row, col);
+        }
+    }
+
+    // Create 2 faces from square
+    int faceVertex = 0;
+    for (int row = 0; row < height - 1; row++) {
+        for (int col = 0; col < width - 1; col++) {
+            int baseIndex = row * width + col;
+            // first (UR) triangle
+            faceVertices[faceVertex++] = baseIndex;
+            faceVertices[faceVertex++] = baseIndex + width + 1;
+            faceVertices[faceVertex++] = baseIndex + 1;
+
+            // second (LL) triangle
+            faceVertices[faceVertex++] = baseIndex;
+            faceVertices[faceVertex++] = baseIndex + width;
+            faceVertices[faceVertex++] = baseIndex + width + 1;
+        }
     }
 }
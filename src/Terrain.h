@@ -1,27 +1,167 @@
 #ifndef TERRAIN
 #define TERRAIN
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+#include "HeightField.h"
+#include "HeightGrid.h"
+#include "HeightPyramid.h"
 #include "IndexedFaceSurface.h"
 
-class Terrain : public IndexedFaceSurface {
+// Header of the binary .demb terrain format, little endian.
+// The file holds rows x columns float32 heights, row-major, at heightsOffset and,
+// if flags has terrainFileHasNormals, the unit normal of every face (3 float32 each,
+// in the same order as Terrain::normals) at normalsOffset. Both offsets are 64-byte aligned.
+struct TerrainFileHeader {
+    // "DEMB"
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t rows;
+    std::uint32_t columns;
+    std::uint32_t flags;
+    // x-y scale the normals were computed with
+    float xyScale;
+    std::uint64_t heightsOffset;
+    std::uint64_t normalsOffset;
+};
+
+constexpr std::uint32_t terrainFileHasNormals = 1;
+
+// The in-memory terrain: the height grid, the min/max pyramid over it and, unless heightfield-only,
+// its triangle mesh. Answers the HeightField queries and the triangle queries on top of them.
+class Terrain final : public IndexedFaceSurface, public HeightField {
 public:
-    // height value per (x, y) coordinate
-    std::vector<std::vector<float>> heightValues;
+    // height value per (x, y) coordinate, in whichever layout setHeightLayout chose
+    HeightGrid heightValues;
+    // min/max heights over blocks of squares, rebuilt whenever a terrain is read
+    HeightPyramid heightBounds;
     float xyScale;
 
     Terrain();
 
-    // reads .dem elevation/terrain model
+    // reads .dem elevation/terrain model, or .demb if the file name ends that way
     // xyScale gives the scale factor to use in the x-y directions
+    // malformed input is reported with its line number and makes this return false
     bool readTerrainFile(const char* fileName, float xyScale);
 
-    // query height at a given (x, y) coordinate
-    float getHeight(float x, float y) const;
+    // layout the heights are stored in, kept across loads (RowMajor by default)
+    void setHeightLayout(HeightGridLayout layout);
+
+    // encoding the heights are stored in, kept across loads (Float32 by default).
+    // Every query decodes Quantized16 heights as it reads them
+    void setHeightEncoding(HeightGridEncoding encoding);
+
+    // Heightfield-only terrains keep just heightValues and heightBounds: vertices, faceVertices and normals
+    // stay empty and faceCorners and faceNormal work them out from the grid, so a terrain costs about
+    // 7 bytes per height instead of about 67. Kept across loads (off by default)
+    void setHeightfieldOnly(bool heightfieldOnly);
+    bool isHeightfieldOnly() const { return heightfieldOnly; }
+
+    // reads only heightValues from a text .dem, parsing large files on several threads;
+    // heightValues is left as it was if the file does not parse
+    bool readHeightValues(const char* fileName);
+
+    // reads a binary .demb terrain, mapping it instead of parsing it
+    // stored normals are used as they are if they were computed with the same xyScale
+    bool readBinaryTerrainFile(const char* fileName, float xyScale);
+
+    // writes the terrain as .demb, with or without its face normals
+    bool writeBinaryTerrainFile(const char* fileName, bool includeNormals) const;
+
+    // query height at a given (x, y) coordinate; off the grid, the height of the nearest point on its edge
+    float getHeight(float x, float y) const override;
 
     // find normal vector at a given (x,y) coordinate
-    Cartesian3 getNormal(float x, float y) const;
+    Cartesian3 getNormal(float x, float y) const override;
+
+    // height and normal at (x, y), looking the grid square up once
+    void getHeightAndNormal(float x, float y, float& height, Cartesian3& normal) const override;
+
+    // Batched queries over count points given as separate x and y arrays, normals as separate
+    // x, y and z arrays. Gathers SimdFloat::width points at a time when SIMD_HAS_GATHER is defined.
+    // Points off the grid, NaN included, take the height and normal of the nearest point on its edge.
+    // Nothing is written before a terrain has been read.
+    void getHeights(const float* x, const float* y, size_t count, float* heights) const;
+    void getNormals(const float* x, const float* y, size_t count,
+                    float* normalX, float* normalY, float* normalZ) const;
+    void getHeightsAndNormals(const float* x, const float* y, size_t count, float* heights,
+                              float* normalX, float* normalY, float* normalZ) const override;
+
+    // true if (x, y) lies over the grid, i.e. getHeight and getNormal are valid there
+    bool contains(float x, float y) const override;
+
+    // the x-y rectangle contains() accepts, minimum included and maximum excluded
+    void getExtent(float& minX, float& minY, float& maxX, float& maxY) const override;
+
+    // False if the terrain stays below height everywhere over the x-y box, judged from the highest
+    // corner of the squares under it. Constant time, and so is maySweepHit.
+    bool mayReach(float minX, float minY, float maxX, float maxY, float height) const override;
+
+    // append the squares under that path whose highest corner reaches the lowest point of the sphere
+    void findSweptSquares(const Cartesian3& start, const Cartesian3& end, float radius,
+                          std::vector<long>& squares) const;
+
+    // First terrain triangle hit by the ray origin + t * direction for t from 0 to maxDistance
+    // (a distance if direction is a unit vector). Walks the grid squares under the ray in order, so it stops at the
+    // first square holding a hit and skips squares whose corners are all above or all below the ray.
+    // On a hit, returns the point, the face normal and the face (an index into normals).
+    // Allocation-free, so safe to call from many threads at once
+    bool castRay(const Cartesian3& origin, const Cartesian3& direction, float maxDistance,
+                 Cartesian3& hitPoint, Cartesian3& hitNormal, size_t& face) const;
+
+    // Faces (indices into normals) whose x-y projection overlaps the box or the disc, in row order,
+    // written to faces up to capacity. Returns how many there are in all, more than capacity if the
+    // buffer was too small. Allocation-free, so safe to call from many threads at once
+    size_t findFacesInBox(float minX, float minY, float maxX, float maxY, size_t* faces, size_t capacity) const;
+    size_t findFacesInCircle(float centreX, float centreY, float radius, size_t* faces, size_t capacity) const;
+
+    // Earliest contact of a sphere moving in a straight line from start to end with the terrain triangles.
+    // On a hit, fraction is how far along the move it happens (0 to 1) and contactNormal is the unit vector
+    // from the touching point to the sphere centre. Contacts the sphere is moving away from are ignored.
+    bool sweepSphere(const Cartesian3& start, const Cartesian3& end, float radius,
+                     float& fraction, Cartesian3& contactNormal) const;
+
+    // two triangles per grid square, whether or not the mesh is stored
+    size_t faceCount() const;
+
+    // corners of a face (an index into normals), in the order faceVertices would list them
+    void faceCorners(size_t face, Cartesian3 corners[3]) const;
+
+    // unit normal of a face, stored or worked out from its corners
+    Cartesian3 faceNormal(size_t face) const;
+
+    const Terrain* asTerrain() const override { return this; }
+
+private:
+    bool heightfieldOnly;
+
+    // offset, flip and divide (x, y) into grid coordinates, clamped onto the grid (see findGridCell)
+    GridCell findCell(float x, float y) const;
+
+    // height by barycentric interpolation inside the cell
+    float cellHeight(const GridCell& cell) const;
+
+    // index into normals of the triangle the cell point lies in
+    size_t cellFace(const GridCell& cell) const;
+
+    // (x, y) in grid units: column from the left edge and row from the top edge, unclamped
+    void toGrid(float x, float y, float& column, float& row) const;
+
+    // position of the height at row and column, the same as its entry in vertices
+    Cartesian3 gridVertex(long row, long column) const;
+
+    // squares under an x-y box, clamped to the grid; false if the box is empty or not a number
+    bool boxSquareRange(float minX, float minY, float maxX, float maxY, long& firstRow,
+                        long& firstColumn, long& lastRow, long& lastColumn) const;
+
+    // shared by the batched queries, skipping any output that is null
+    void queryPoints(const float* x, const float* y, size_t count, float* heights,
+                     float* normalX, float* normalY, float* normalZ) const;
+
+    // fill vertices and faceVertices from heightValues and xyScale, or empty them if heightfield-only
+    void buildSurface();
 };
 
 #endif
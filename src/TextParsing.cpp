@@ -0,0 +1,181 @@
+#include "TextParsing.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#include "WorkStealingExecutor.h"
+
+// inputs smaller than this per part are parsed on the calling thread
+constexpr size_t minimumPartBytes = 1 << 20;
+
+// parts per hardware thread, so that work stealing can even out uneven parts
+constexpr size_t partsPerThread = 4;
+
+static bool isWhitespace(const char character) {
+    return character == ' ' || character == '\t' || character == '\r' || character == '\n' ||
+           character == '\v' || character == '\f';
+}
+
+TextCursor::TextCursor(const char* begin, const char* end, const long line)
+    : position(begin),
+      end(end),
+      line(line) {
+}
+
+void TextCursor::skipWhitespace() {
+    while (position < end && isWhitespace(*position)) {
+        if (*position == '\n') {
+            line++;
+        }
+        position++;
+    }
+}
+
+void TextCursor::skipBlanks() {
+    while (position < end && (*position == ' ' || *position == '\t' || *position == '\r')) {
+        position++;
+    }
+}
+
+bool TextCursor::atEnd() {
+    skipWhitespace();
+    return position == end;
+}
+
+void TextCursor::skipLine() {
+    const void* newline = std::memchr(position, '\n', end - position);
+    if (newline == nullptr) {
+        position = end;
+        return;
+    }
+    position = static_cast<const char*>(newline) + 1;
+    line++;
+}
+
+bool TextCursor::readFloat(float& value) {
+    skipWhitespace();
+    // from_chars does not accept an explicit plus sign, stream extraction does
+    const char* start = position < end && *position == '+' ? position + 1 : position;
+    const auto [next, error] = std::from_chars(start, end, value);
+    if (error != std::errc() || (next < end && !isWhitespace(*next))) {
+        return false;
+    }
+    position = next;
+    return true;
+}
+
+bool TextCursor::readLong(long& value) {
+    skipWhitespace();
+    const char* start = position < end && *position == '+' ? position + 1 : position;
+    const auto [next, error] = std::from_chars(start, end, value);
+    if (error != std::errc() || (next < end && !isWhitespace(*next))) {
+        return false;
+    }
+    position = next;
+    return true;
+}
+
+bool TextCursor::readInt(int& value) {
+    long longValue = 0;
+    const char* start = position;
+    const long startLine = line;
+    if (!readLong(longValue) || longValue < std::numeric_limits<int>::min() ||
+        longValue > std::numeric_limits<int>::max()) {
+        position = start;
+        line = startLine;
+        return false;
+    }
+    value = static_cast<int>(longValue);
+    return true;
+}
+
+bool TextCursor::expectWord(const char* expected) {
+    skipWhitespace();
+    const size_t length = std::strlen(expected);
+    if (static_cast<size_t>(end - position) < length || std::memcmp(position, expected, length) != 0 ||
+        (position + length < end && !isWhitespace(position[length]))) {
+        return false;
+    }
+    position += length;
+    return true;
+}
+
+bool TextCursor::expectText(const char* expected) {
+    skipWhitespace();
+    const size_t length = std::strlen(expected);
+    if (static_cast<size_t>(end - position) < length || std::memcmp(position, expected, length) != 0) {
+        return false;
+    }
+    position += length;
+    return true;
+}
+
+std::vector<const char*> splitAtLines(const char* begin, const char* end, const size_t parts) {
+    std::vector<const char*> boundaries{begin};
+    const size_t partBytes = (end - begin) / std::max<size_t>(1, parts);
+
+    const char* position = begin;
+    for (size_t part = 1; part < parts && partBytes > 0; part++) {
+        position = std::max(position, begin + part * partBytes);
+        if (position >= end) {
+            break;
+        }
+        const void* newline = std::memchr(position, '\n', end - position);
+        if (newline == nullptr) {
+            break;
+        }
+        position = static_cast<const char*>(newline) + 1;
+        if (position > boundaries.back() && position < end) {
+            boundaries.push_back(position);
+        }
+    }
+
+    boundaries.push_back(end);
+    return boundaries;
+}
+
+void countTokensAndLines(const char* begin, const char* end, size_t& tokens, long& lines) {
+    tokens = 0;
+    lines = 0;
+    bool isInToken = false;
+    for (const char* position = begin; position < end; position++) {
+        const bool isSeparator = isWhitespace(*position);
+        if (*position == '\n') {
+            lines++;
+        }
+        if (!isSeparator && !isInToken) {
+            tokens++;
+        }
+        isInToken = !isSeparator;
+    }
+}
+
+size_t textPartCount(const size_t inputBytes) {
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 1) {
+        return 1;
+    }
+    return std::max<size_t>(1, std::min(threads * partsPerThread, inputBytes / minimumPartBytes));
+}
+
+void forEachTextPart(const size_t inputBytes, const size_t parts, const std::function<void(size_t part)>& job) {
+    if (parts <= 1 || inputBytes < minimumPartBytes) {
+        for (size_t part = 0; part < parts; part++) {
+            job(part);
+        }
+        return;
+    }
+
+    WorkStealingExecutor executor;
+    executor.parallelFor(parts, [&job](const size_t part, unsigned) {
+        job(part);
+    });
+}
+
+void reportParseError(const char* fileName, const long line, const std::string& message) {
+    std::cerr << fileName << ':' << line << ": " << message << std::endl;
+}
@@ -0,0 +1,65 @@
+#ifndef TEXT_PARSING_H
+#define TEXT_PARSING_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Helpers for the text formats (.dem, .face): whitespace separated numbers
+// read in bulk with std::from_chars, with line numbers kept for error messages.
+
+// Cursor over a text buffer, counting lines as it skips whitespace
+class TextCursor {
+public:
+    const char* position;
+    const char* end;
+    // line of position, starting at 1
+    long line;
+
+    TextCursor(const char* begin, const char* end, long line);
+
+    // skip spaces, tabs, carriage returns and newlines
+    void skipWhitespace();
+
+    // skip spaces and tabs only, stopping at the end of the line
+    void skipBlanks();
+
+    // true once only whitespace is left
+    bool atEnd();
+
+    // move past the next newline, or to the end
+    void skipLine();
+
+    // each read skips leading whitespace and fails without moving if no number is there
+    bool readFloat(float& value);
+
+    bool readLong(long& value);
+
+    bool readInt(int& value);
+
+    // read the next whitespace separated word and compare it with expected
+    bool expectWord(const char* expected);
+
+    // skip whitespace and move past expected if the text continues with it, e.g. a "key=" before a number
+    bool expectText(const char* expected);
+};
+
+// Boundaries of about parts pieces of [begin, end), each ending just after a newline.
+// The result starts with begin and finishes with end.
+std::vector<const char*> splitAtLines(const char* begin, const char* end, size_t parts);
+
+// number of whitespace separated tokens and of newlines in [begin, end)
+void countTokensAndLines(const char* begin, const char* end, size_t& tokens, long& lines);
+
+// Run job(part) for part in [0, parts): on a temporary thread pool if the input is large
+// enough to repay starting one, otherwise on the calling thread.
+void forEachTextPart(size_t inputBytes, size_t parts, const std::function<void(size_t part)>& job);
+
+// number of parts to split inputBytes into, 1 for small inputs
+size_t textPartCount(size_t inputBytes);
+
+// "fileName:line: message" on the standard error stream
+void reportParseError(const char* fileName, long line, const std::string& message);
+
+#endif
@@ -0,0 +1,440 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "Geometry.h"
+
+// the queries keep one stack entry per level, so no build goes deeper than this
+constexpr int maxDepth = 64;
+
+// centroid bins per axis tried as split positions
+constexpr int binCount = 16;
+
+// nodes with more triangles than this are split even if the heuristic prefers a leaf
+constexpr size_t maxLeafSize = 16;
+
+// cost of visiting a node, relative to testing one triangle
+constexpr float traversalCost = 1.0f;
+
+// half the surface area of a box, which is all the heuristic compares
+static float halfArea(const Cartesian3& lower, const Cartesian3& upper) {
+    const float x = upper.x - lower.x;
+    const float y = upper.y - lower.y;
+    const float z = upper.z - lower.z;
+    return x * y + y * z + z * x;
+}
+
+static void grow(Cartesian3& lower, Cartesian3& upper, const Cartesian3& pointLower, const Cartesian3& pointUpper) {
+    lower.x = std::min(lower.x, pointLower.x);
+    lower.y = std::min(lower.y, pointLower.y);
+    lower.z = std::min(lower.z, pointLower.z);
+    upper.x = std::max(upper.x, pointUpper.x);
+    upper.y = std::max(upper.y, pointUpper.y);
+    upper.z = std::max(upper.z, pointUpper.z);
+}
+
+// Point of a triangle nearest to point, by the Voronoi region of the triangle it lies in
+// (Ericson, Real-Time Collision Detection, 5.1.5)
+static Cartesian3 nearestOnTriangle(const Cartesian3& point, const Cartesian3* corners) {
+    const Cartesian3& a = corners[0];
+    const Cartesian3& b = corners[1];
+    const Cartesian3& c = corners[2];
+    const Cartesian3 ab = b - a;
+    const Cartesian3 ac = c - a;
+    const Cartesian3 ap = point - a;
+    const float d1 = ab.dot(ap);
+    const float d2 = ac.dot(ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+    const Cartesian3 bp = point - b;
+    const float d3 = ab.dot(bp);
+    const float d4 = ac.dot(bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return b;
+    }
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    const Cartesian3 cp = point - c;
+    const float d5 = ab.dot(cp);
+    const float d6 = ac.dot(cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return c;
+    }
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const float denominator = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+void TriangleBvh::build(const IndexedFaceSurface& surface, WorkStealingExecutor* executor) {
+    nodes.clear();
+    corners.clear();
+    faces.clear();
+    const size_t faceCount = surface.faceVertices.size() / 3;
+    if (faceCount == 0) {
+        return;
+    }
+
+    std::vector<BuildTriangle> buildTriangles(faceCount);
+    for (size_t face = 0; face < faceCount; face++) {
+        BuildTriangle& triangle = buildTriangles[face];
+        const Cartesian3& first = surface.vertices[surface.faceVertices[3 * face]];
+        triangle.lower = first;
+        triangle.upper = first;
+        for (int corner = 1; corner < 3; corner++) {
+            const Cartesian3& vertex = surface.vertices[surface.faceVertices[3 * face + corner]];
+            grow(triangle.lower, triangle.upper, vertex, vertex);
+        }
+        triangle.centroid = (triangle.lower + triangle.upper) * 0.5f;
+        triangle.face = static_cast<std::uint32_t>(face);
+    }
+
+    // the root's slot is padded to a pair, so every pair of children starts on a cache line
+    nodes.resize(2);
+    if (executor == nullptr) {
+        buildNode(buildTriangles, 0, faceCount, nodes, 0, 0, 0, nullptr);
+    } else {
+        // enough subtrees below the top levels for every worker to have several to take or steal
+        int parallelDepth = 0;
+        while ((1u << parallelDepth) < 4 * executor->threadCount() && parallelDepth < maxDepth / 2) {
+            parallelDepth++;
+        }
+        std::vector<size_t> pending;
+        buildNode(buildTriangles, 0, faceCount, nodes, 0, 0, parallelDepth, &pending);
+
+        // each subtree works on its own slice of buildTriangles and into its own nodes
+        std::vector<NodeArray> subtrees(pending.size());
+        executor->parallelFor(pending.size(), [&](const size_t index, unsigned) {
+            const Node& root = nodes[pending[index]];
+            subtrees[index].resize(2);
+            buildNode(buildTriangles, root.first, root.first + root.count, subtrees[index], 0, parallelDepth,
+                      0, nullptr);
+        });
+
+        // then they are appended, the root of each taking the place of its pending node
+        for (size_t index = 0; index < pending.size(); index++) {
+            const NodeArray& subtree = subtrees[index];
+            const std::uint32_t offset = static_cast<std::uint32_t>(nodes.size()) - 2;
+            nodes.insert(nodes.end(), subtree.begin() + 2, subtree.end());
+            nodes[pending[index]] = subtree[0];
+            for (size_t node = nodes.size() - (subtree.size() - 2); node < nodes.size(); node++) {
+                if (nodes[node].count == 0) {
+                    nodes[node].first += offset;
+                }
+            }
+            if (nodes[pending[index]].count == 0) {
+                nodes[pending[index]].first += offset;
+            }
+        }
+    }
+
+    corners.resize(3 * faceCount);
+    faces.resize(faceCount);
+    for (size_t slot = 0; slot < faceCount; slot++) {
+        const size_t face = buildTriangles[slot].face;
+        faces[slot] = buildTriangles[slot].face;
+        for (int corner = 0; corner < 3; corner++) {
+            corners[3 * slot + corner] = surface.vertices[surface.faceVertices[3 * face + corner]];
+        }
+    }
+}
+
+void TriangleBvh::buildNode(std::vector<BuildTriangle>& buildTriangles, const size_t begin, const size_t end,
+                            NodeArray& subtreeNodes, const size_t node, const int depth,
+                            const int maxParallelDepth, std::vector<size_t>* pending) const {
+    Cartesian3 lower = buildTriangles[begin].lower;
+    Cartesian3 upper = buildTriangles[begin].upper;
+    Cartesian3 centroidLower = buildTriangles[begin].centroid;
+    Cartesian3 centroidUpper = buildTriangles[begin].centroid;
+    for (size_t triangle = begin + 1; triangle < end; triangle++) {
+        grow(lower, upper, buildTriangles[triangle].lower, buildTriangles[triangle].upper);
+        grow(centroidLower, centroidUpper, buildTriangles[triangle].centroid, buildTriangles[triangle].centroid);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        subtreeNodes[node].lower[axis] = lower[axis];
+        subtreeNodes[node].upper[axis] = upper[axis];
+    }
+    subtreeNodes[node].first = static_cast<std::uint32_t>(begin);
+    subtreeNodes[node].count = static_cast<std::uint32_t>(end - begin);
+
+    const size_t count = end - begin;
+    if (count <= leafSize || depth >= maxDepth) {
+        return;
+    }
+    if (pending != nullptr && depth >= maxParallelDepth) {
+        pending->push_back(node);
+        return;
+    }
+
+    // the split between two bins along some axis with the lowest heuristic cost
+    // (triangles on each side times the area of their bounds)
+    int bestAxis = -1;
+    int bestBin = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        const float extent = centroidUpper[axis] - centroidLower[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        const float binScale = binCount / extent;
+        size_t binCounts[binCount] = {};
+        Cartesian3 binLower[binCount];
+        Cartesian3 binUpper[binCount];
+        for (size_t triangle = begin; triangle < end; triangle++) {
+            const BuildTriangle& built = buildTriangles[triangle];
+            const int bin = std::min(binCount - 1, static_cast<int>((built.centroid[axis] - centroidLower[axis]) * binScale));
+            if (binCounts[bin]++ == 0) {
+                binLower[bin] = built.lower;
+                binUpper[bin] = built.upper;
+            } else {
+                grow(binLower[bin], binUpper[bin], built.lower, built.upper);
+            }
+        }
+
+        // areas and counts left of each split, swept from the left, then the right side swept back
+        float leftCost[binCount - 1];
+        size_t leftCount = 0;
+        Cartesian3 sideLower, sideUpper;
+        for (int bin = 0; bin < binCount - 1; bin++) {
+            if (binCounts[bin] > 0) {
+                if (leftCount == 0) {
+                    sideLower = binLower[bin];
+                    sideUpper = binUpper[bin];
+                } else {
+                    grow(sideLower, sideUpper, binLower[bin], binUpper[bin]);
+                }
+                leftCount += binCounts[bin];
+            }
+            leftCost[bin] = leftCount * (leftCount > 0 ? halfArea(sideLower, sideUpper) : 0.0f);
+        }
+        size_t rightCount = 0;
+        for (int bin = binCount - 1; bin > 0; bin--) {
+            if (binCounts[bin] > 0) {
+                if (rightCount == 0) {
+                    sideLower = binLower[bin];
+                    sideUpper = binUpper[bin];
+                } else {
+                    grow(sideLower, sideUpper, binLower[bin], binUpper[bin]);
+                }
+                rightCount += binCounts[bin];
+            }
+            // split after bin - 1: both sides need triangles
+            if (rightCount > 0 && rightCount < count) {
+                const float cost = leftCost[bin - 1] + rightCount * halfArea(sideLower, sideUpper);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin - 1;
+                }
+            }
+        }
+    }
+
+    // every centroid in one place: no split separates them
+    if (bestAxis < 0) {
+        return;
+    }
+    const float splitCost = traversalCost + bestCost / halfArea(lower, upper);
+    if (splitCost >= count && count <= maxLeafSize) {
+        return;
+    }
+
+    const float binScale = binCount / (centroidUpper[bestAxis] - centroidLower[bestAxis]);
+    const auto middle = std::partition(buildTriangles.begin() + begin, buildTriangles.begin() + end,
+                                       [&](const BuildTriangle& built) {
+                                           const int bin = std::min(binCount - 1, static_cast<int>(
+                                               (built.centroid[bestAxis] - centroidLower[bestAxis]) * binScale));
+                                           return bin <= bestBin;
+                                       });
+    const size_t split = middle - buildTriangles.begin();
+
+    const size_t children = subtreeNodes.size();
+    subtreeNodes.resize(children + 2);
+    subtreeNodes[node].first = static_cast<std::uint32_t>(children);
+    subtreeNodes[node].count = 0;
+    buildNode(buildTriangles, begin, split, subtreeNodes, children, depth + 1, maxParallelDepth, pending);
+    buildNode(buildTriangles, split, end, subtreeNodes, children + 1, depth + 1, maxParallelDepth, pending);
+}
+
+// Parameter at which the ray enters a node's box, if it does before maxT
+static bool rayEntersBox(const float lower[3], const float upper[3], const Cartesian3& origin,
+                         const Cartesian3& inverseDirection, const float maxT, float& enterT) {
+    float nearT = 0.0f;
+    float farT = maxT;
+    for (int axis = 0; axis < 3; axis++) {
+        const float first = (lower[axis] - origin[axis]) * inverseDirection[axis];
+        const float second = (upper[axis] - origin[axis]) * inverseDirection[axis];
+        nearT = std::max(nearT, std::min(first, second));
+        farT = std::min(farT, std::max(first, second));
+    }
+    enterT = nearT;
+    return nearT <= farT;
+}
+
+// squared distance from point to a node's box, zero inside it
+static float boxDistanceSquared(const float lower[3], const float upper[3], const Cartesian3& point) {
+    float distanceSquared = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        const float outside = std::max({lower[axis] - point[axis], 0.0f, point[axis] - upper[axis]});
+        distanceSquared += outside * outside;
+    }
+    return distanceSquared;
+}
+
+bool TriangleBvh::castRay(const Cartesian3& origin, const Cartesian3& direction, const float maxDistance,
+                          Cartesian3& hitPoint, Cartesian3& hitNormal, size_t& face) const {
+    float enterT;
+    const Cartesian3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    if (empty() || !rayEntersBox(nodes[0].lower, nodes[0].upper, origin, inverseDirection, maxDistance, enterT)) {
+        return false;
+    }
+
+    // depth first, nearer child first, so later boxes are mostly cut off by the hit found so far
+    std::uint32_t stack[maxDepth + 1];
+    int stackSize = 0;
+    std::uint32_t current = 0;
+    float bestT = maxDistance;
+    long bestSlot = -1;
+    for (;;) {
+        const Node& node = nodes[current];
+        if (node.count > 0) {
+            for (std::uint32_t slot = node.first; slot < node.first + node.count; slot++) {
+                float t;
+                if (intersectRayTriangle(origin, direction, &corners[3 * slot], t) && t >= 0.0f && t <= bestT) {
+                    bestT = t;
+                    bestSlot = slot;
+                }
+            }
+        } else {
+            float firstT, secondT;
+            const Node& first = nodes[node.first];
+            const Node& second = nodes[node.first + 1];
+            const bool isFirstHit = rayEntersBox(first.lower, first.upper, origin, inverseDirection, bestT, firstT);
+            const bool isSecondHit = rayEntersBox(second.lower, second.upper, origin, inverseDirection, bestT, secondT);
+            if (isFirstHit && isSecondHit) {
+                const bool isFirstNearer = firstT <= secondT;
+                stack[stackSize++] = isFirstNearer ? node.first + 1 : node.first;
+                current = isFirstNearer ? node.first : node.first + 1;
+                continue;
+            }
+            if (isFirstHit || isSecondHit) {
+                current = isFirstHit ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        current = stack[--stackSize];
+    }
+
+    if (bestSlot < 0) {
+        return false;
+    }
+    const Cartesian3* triangle = &corners[3 * bestSlot];
+    hitPoint = origin + direction * bestT;
+    hitNormal = (triangle[1] - triangle[0]).cross(triangle[2] - triangle[0]).unit();
+    face = faces[bestSlot];
+    return true;
+}
+
+size_t TriangleBvh::findFacesTouchingSphere(const Cartesian3& centre, const float radius, size_t* facesFound,
+                                            const size_t capacity) const {
+    const float radiusSquared = radius * radius;
+    if (empty() || radius < 0.0f || boxDistanceSquared(nodes[0].lower, nodes[0].upper, centre) > radiusSquared) {
+        return 0;
+    }
+
+    std::uint32_t stack[maxDepth + 1];
+    int stackSize = 0;
+    std::uint32_t current = 0;
+    size_t found = 0;
+    for (;;) {
+        const Node& node = nodes[current];
+        if (node.count > 0) {
+            for (std::uint32_t slot = node.first; slot < node.first + node.count; slot++) {
+                const Cartesian3 offset = nearestOnTriangle(centre, &corners[3 * slot]) - centre;
+                if (offset.dot(offset) <= radiusSquared) {
+                    if (found < capacity) {
+                        facesFound[found] = faces[slot];
+                    }
+                    found++;
+                }
+            }
+        } else {
+            const bool isFirstHit = boxDistanceSquared(nodes[node.first].lower, nodes[node.first].upper,
+                                                       centre) <= radiusSquared;
+            const bool isSecondHit = boxDistanceSquared(nodes[node.first + 1].lower, nodes[node.first + 1].upper,
+                                                        centre) <= radiusSquared;
+            if (isFirstHit && isSecondHit) {
+                stack[stackSize++] = node.first + 1;
+            }
+            if (isFirstHit || isSecondHit) {
+                current = isFirstHit ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        if (stackSize == 0) {
+            return found;
+        }
+        current = stack[--stackSize];
+    }
+}
+
+bool TriangleBvh::findNearestPoint(const Cartesian3& point, const float maxDistance, Cartesian3& nearest,
+                                   size_t& face) const {
+    float bestSquared = maxDistance * maxDistance;
+    if (empty() || maxDistance < 0.0f || boxDistanceSquared(nodes[0].lower, nodes[0].upper, point) > bestSquared) {
+        return false;
+    }
+
+    // nearer child first, each box skipped once the nearest point so far is closer than it
+    std::uint32_t stack[maxDepth + 1];
+    int stackSize = 0;
+    std::uint32_t current = 0;
+    long bestSlot = -1;
+    for (;;) {
+        const Node& node = nodes[current];
+        if (boxDistanceSquared(node.lower, node.upper, point) <= bestSquared) {
+            if (node.count > 0) {
+                for (std::uint32_t slot = node.first; slot < node.first + node.count; slot++) {
+                    const Cartesian3 candidate = nearestOnTriangle(point, &corners[3 * slot]);
+                    const Cartesian3 offset = candidate - point;
+                    if (offset.dot(offset) <= bestSquared) {
+                        bestSquared = offset.dot(offset);
+                        bestSlot = slot;
+                        nearest = candidate;
+                    }
+                }
+            } else {
+                const float firstSquared = boxDistanceSquared(nodes[node.first].lower, nodes[node.first].upper, point);
+                const float secondSquared = boxDistanceSquared(nodes[node.first + 1].lower,
+                                                               nodes[node.first + 1].upper, point);
+                const bool isFirstNearer = firstSquared <= secondSquared;
+                stack[stackSize++] = isFirstNearer ? node.first + 1 : node.first;
+                current = isFirstNearer ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        current = stack[--stackSize];
+    }
+
+    if (bestSlot < 0) {
+        return false;
+    }
+    face = faces[bestSlot];
+    return true;
+}
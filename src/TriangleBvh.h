@@ -0,0 +1,108 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "Cartesian3.h"
+#include "IndexedFaceSurface.h"
+#include "WorkStealingExecutor.h"
+
+// Bounding volume hierarchy over the triangles of any IndexedFaceSurface, for meshes that are not
+// height fields: overhangs, bowls, scanned arenas.
+// Built top-down, splitting each node where the surface area heuristic (the expected cost of a query
+// reaching it) is lowest among binned centroid positions. The nodes live in one array with the two children
+// of a node side by side. The array is cache line aligned and the root's slot is padded to a pair, so a
+// node pair fills one cache line. The corners of the triangles are copied in leaf order, so a leaf
+// reads one contiguous run of them.
+// The queries only read the hierarchy and allocate nothing, so many threads can share one.
+class TriangleBvh {
+public:
+    // triangles per leaf below which a node is never split
+    static constexpr int leafSize = 4;
+
+    // Rebuild over the faces of surface. With an executor the top levels are split first,
+    // then the subtrees under them are built in parallel
+    void build(const IndexedFaceSurface& surface, WorkStealingExecutor* executor = nullptr);
+
+    bool empty() const { return nodes.empty(); }
+
+    size_t nodeCount() const { return nodes.empty() ? 0 : nodes.size() - 1; }
+
+    // First triangle hit by the ray origin + t * direction for t from 0 to maxDistance, from either side.
+    // On a hit, returns the point, the unit normal of the triangle (by its counter-clockwise winding)
+    // and the face (an index into the surface's faces)
+    bool castRay(const Cartesian3& origin, const Cartesian3& direction, float maxDistance,
+                 Cartesian3& hitPoint, Cartesian3& hitNormal, size_t& face) const;
+
+    // Faces with any point within radius of centre, i.e. the triangles a sphere there overlaps,
+    // written to faces up to capacity. Returns how many there are in all, more than capacity if the
+    // buffer was too small
+    size_t findFacesTouchingSphere(const Cartesian3& centre, float radius, size_t* faces, size_t capacity) const;
+
+    // Point of the mesh nearest to point, if any lies within maxDistance of it: for a sphere centred
+    // at point, the direction and depth of its deepest contact with the mesh
+    bool findNearestPoint(const Cartesian3& point, float maxDistance, Cartesian3& nearest, size_t& face) const;
+
+private:
+    // Bounds of everything below the node. A leaf has count triangles from index first on,
+    // an interior node (count 0) has its children at first and first + 1
+    struct Node {
+        float lower[3];
+        float upper[3];
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+    static_assert(sizeof(Node) == 32, "two nodes must fill a cache line");
+
+    // allocates nodes on cache line boundaries, so that the pairs at even indices share a line
+    template <typename T>
+    struct CacheLineAllocator {
+        using value_type = T;
+
+        CacheLineAllocator() = default;
+
+        template <typename U>
+        CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+        T* allocate(const size_t count) {
+            return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(64)));
+        }
+
+        void deallocate(T* pointer, size_t) {
+            ::operator delete(pointer, std::align_val_t(64));
+        }
+
+        template <typename U>
+        bool operator ==(const CacheLineAllocator<U>&) const { return true; }
+
+        template <typename U>
+        bool operator !=(const CacheLineAllocator<U>&) const { return false; }
+    };
+
+    // the root at 0 and an unused slot at 1, then the children of each interior node as a pair
+    using NodeArray = std::vector<Node, CacheLineAllocator<Node>>;
+
+    // a triangle while building: its bounds and centroid, and the face it came from
+    struct BuildTriangle {
+        Cartesian3 lower;
+        Cartesian3 upper;
+        Cartesian3 centroid;
+        std::uint32_t face;
+    };
+
+    NodeArray nodes;
+    // 3 corners per triangle, in leaf order
+    std::vector<Cartesian3> corners;
+    // face of each triangle, in leaf order
+    std::vector<std::uint32_t> faces;
+
+    // Split buildTriangles[begin, end) into node, appending its descendants to subtreeNodes.
+    // Stops at maxParallelDepth, recording the node in pending instead, if pending is given
+    void buildNode(std::vector<BuildTriangle>& buildTriangles, size_t begin, size_t end, NodeArray& subtreeNodes,
+                   size_t node, int depth, int maxParallelDepth, std::vector<size_t>* pending) const;
+};
+
+#endif
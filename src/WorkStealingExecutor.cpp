@@ -0,0 +1,149 @@
+#include "WorkStealingExecutor.h"
+
+#include <algorithm>
+
+WorkStealingExecutor::WorkStealingExecutor(unsigned threadCount)
+    : job(nullptr),
+      grainSize(1),
+      batchNumber(0),
+      busyWorkers(0),
+      isStopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned worker = 0; worker < threadCount; worker++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (unsigned worker = 0; worker < threadCount; worker++) {
+        threads.emplace_back(&WorkStealingExecutor::workerLoop, this, worker);
+    }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        isStopping = true;
+    }
+    batchStarted.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+unsigned WorkStealingExecutor::threadCount() const {
+    return threads.size();
+}
+
+void WorkStealingExecutor::parallelFor(const size_t count,
+                                       const std::function<void(size_t index, unsigned worker)>& batchJob,
+                                       const size_t batchGrainSize) {
+    if (count == 0) {
+        return;
+    }
+
+    // deal the index space out evenly, one contiguous range per worker
+    const size_t workers = queues.size();
+    for (size_t worker = 0; worker < workers; worker++) {
+        const size_t begin = count * worker / workers;
+        const size_t end = count * (worker + 1) / workers;
+        if (begin < end) {
+            std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+            queues[worker]->ranges.push_back({begin, end});
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(batchMutex);
+    job = &batchJob;
+    grainSize = std::max<size_t>(1, batchGrainSize);
+    busyWorkers = workers;
+    firstException = nullptr;
+    batchNumber++;
+    batchStarted.notify_all();
+
+    batchFinished.wait(lock, [this] { return busyWorkers == 0; });
+    job = nullptr;
+
+    if (firstException) {
+        std::rethrow_exception(firstException);
+    }
+}
+
+void WorkStealingExecutor::workerLoop(const unsigned worker) {
+    unsigned long lastBatch = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(batchMutex);
+            batchStarted.wait(lock, [this, lastBatch] { return isStopping || batchNumber != lastBatch; });
+            if (isStopping) {
+                return;
+            }
+            lastBatch = batchNumber;
+        }
+
+        runBatch(worker);
+
+        std::lock_guard<std::mutex> lock(batchMutex);
+        if (--busyWorkers == 0) {
+            batchFinished.notify_all();
+        }
+    }
+}
+
+void WorkStealingExecutor::runBatch(const unsigned worker) {
+    // A range is split completely as soon as it is taken, so once no queue has a range left the rest of
+    // the batch is already in the hands of other workers: leave it to them and wait for the next batch
+    Range range{};
+    while (popRange(worker, range) || stealRange(worker, range)) {
+        // eager binary splitting down to grainSize: push each upper half for thieves, keep the lowest grain
+        while (range.end - range.begin > grainSize) {
+            const size_t middle = range.begin + (range.end - range.begin) / 2;
+            {
+                std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+                queues[worker]->ranges.push_back({middle, range.end});
+            }
+            range.end = middle;
+        }
+
+        for (size_t index = range.begin; index < range.end; index++) {
+            try {
+                (*job)(index, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(batchMutex);
+                if (!firstException) {
+                    firstException = std::current_exception();
+                }
+            }
+        }
+    }
+}
+
+bool WorkStealingExecutor::popRange(const unsigned worker, Range& range) {
+    WorkerQueue& queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ranges.empty()) {
+        return false;
+    }
+
+    // newest range: the one split off most recently, closest to what this worker just did
+    range = queue.ranges.back();
+    queue.ranges.pop_back();
+    return true;
+}
+
+bool WorkStealingExecutor::stealRange(const unsigned worker, Range& range) {
+    const unsigned workers = queues.size();
+    for (unsigned offset = 1; offset < workers; offset++) {
+        WorkerQueue& victim = *queues[(worker + offset) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.ranges.empty()) {
+            // oldest range: the largest one left by the victim
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
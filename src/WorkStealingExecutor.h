@@ -0,0 +1,84 @@
+#ifndef WORK_STEALING_EXECUTOR_H
+#define WORK_STEALING_EXECUTOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads running index-space jobs with work stealing.
+// Each worker owns a deque of index ranges: it splits and works on the newest range itself,
+// and idle workers steal the oldest (largest) range from the others.
+// Results are written by index, so their order never depends on scheduling.
+class WorkStealingExecutor {
+public:
+    // threadCount = 0 uses every hardware thread
+    explicit WorkStealingExecutor(unsigned threadCount = 0);
+
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+
+    WorkStealingExecutor& operator =(const WorkStealingExecutor&) = delete;
+
+    unsigned threadCount() const;
+
+    // call job(index, worker) for every index in [0, count) and wait for all of them.
+    // worker is in [0, threadCount()) and identifies the calling thread, for per-worker scratch state.
+    // Ranges of up to grainSize indices are never split further.
+    // The first exception thrown by a job is rethrown here once every worker has stopped.
+    // Not reentrant: jobs must not call back into the same executor.
+    void parallelFor(size_t count, const std::function<void(size_t index, unsigned worker)>& job,
+                     size_t grainSize = 1);
+
+    // results[index] = job(index, worker), in index order
+    template <typename Result, typename Job>
+    std::vector<Result> map(const size_t count, Job&& job, const size_t grainSize = 1) {
+        std::vector<Result> results(count);
+        parallelFor(count, [&results, &job](const size_t index, const unsigned worker) {
+            results[index] = job(index, worker);
+        }, grainSize);
+        return results;
+    }
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    // current batch, guarded by batchMutex
+    std::mutex batchMutex;
+    std::condition_variable batchStarted;
+    std::condition_variable batchFinished;
+    const std::function<void(size_t, unsigned)>* job;
+    size_t grainSize;
+    unsigned long batchNumber;
+    unsigned busyWorkers;
+    bool isStopping;
+    std::exception_ptr firstException;
+
+    void workerLoop(unsigned worker);
+
+    // run ranges from the own queue or stolen ones until none is left to take
+    void runBatch(unsigned worker);
+
+    bool popRange(unsigned worker, Range& range);
+
+    bool stealRange(unsigned worker, Range& range);
+};
+
+#endif
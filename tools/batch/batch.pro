@@ -0,0 +1,11 @@
+# Headless batch simulation runner, no Qt or OpenGL required
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+TARGET = ../../bin/ball-impulse-batch
+OBJECTS_DIR=../../build/batch/obj
+
+include(../../common.pri)
+include(../../core/core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,491 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BallSet.h"
+#include "BinaryIO.h"
+#include "HeightField.h"
+#include "IndexedFaceSurface.h"
+#include "LaunchSweep.h"
+#include "PagedTerrain.h"
+#include "PhysicsConstants.h"
+#include "Simulation.h"
+#include "Terrain.h"
+#include "WorkStealingExecutor.h"
+
+// Headless batch runner: launches the ball N times around +Z on one terrain,
+// as fast as the CPU allows, and writes one CSV row per launch.
+// With --balls all launches fly at once in SIMD ball sets.
+// With --sweep-* options it runs a grid of launch angles x speeds x heights instead.
+// Launches are spread over every core; the terrain and ball model are shared read-only.
+// A tiled .demt terrain is paged in from disk instead of loaded, for spheres stepped once per frame.
+
+// a ball touching the terrain slower than this is considered at rest
+constexpr float restSpeedThreshold = 0.2f;
+
+// balls per ball set in --balls mode, one ball set per parallel job
+constexpr long ballSetChunkSize = 4096;
+
+constexpr size_t bytesPerMegabyte = 1024 * 1024;
+
+struct BatchOptions {
+    std::string terrainFileName = "assets/rollingland.dem";
+    float xyScale = 3.0f;
+    HeightGridLayout heightLayout = HeightGridLayout::RowMajor;
+    bool heightfieldOnly = false;
+    bool quantizeHeights = false;
+    // .demt only: tiles kept resident, in megabytes
+    size_t memoryBudget = 1024;
+    std::string ballFileName = "assets/spheroid.face";
+    bool useSphere = true;
+    bool continuousCollision = false;
+    bool eventDriven = false;
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    bool useBallSet = false;
+    bool collideBalls = false;
+    long launches = 72;
+    float launchSpeed = 5.0f;
+    float launchHeight = 10.0f;
+    float frameTime = 0.0166667f;
+    float duration = 30.0f;
+    std::string outputFileName;
+    unsigned threads = 0;
+    // sweep mode, enabled by any --sweep-* option
+    bool isSweep = false;
+    SweepAxis sweepAngles{0.0f, 355.0f, 72};
+    SweepAxis sweepSpeeds{5.0f, 5.0f, 1};
+    SweepAxis sweepHeights{10.0f, 10.0f, 1};
+    std::string rasterFileName;
+};
+
+// what a single launch produced
+struct LaunchResult {
+    float launchAngle;
+    Cartesian3 landingPosition;
+    float landingTime;
+    unsigned long bounceCount;
+    Cartesian3 finalPosition;
+    Cartesian3 finalVelocity;
+    float elapsedTime;
+    unsigned long frames;
+    SimulationOutcome outcome;
+};
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --terrain <file.dem>   terrain to launch on (default assets/rollingland.dem); a tiled .demt\n"
+              << "                         is paged in from disk, for spheres without --continuous or --event-driven\n"
+              << "  --memory <MB>          .demt tiles kept resident (default 1024)\n"
+              << "  --scale <s>            terrain x-y scale (default 3)\n"
+              << "  --layout <l>           terrain height storage: rowmajor, tiled or morton (default rowmajor)\n"
+              << "  --heightfield          keep only the terrain heights, generating its triangles on demand\n"
+              << "  --quantize             store the terrain heights in 16 bits and report the error\n"
+              << "  --ball <file.face>     ball model (default assets/spheroid.face)\n"
+              << "  --polyhedron           collide the ball as a polyhedron instead of a sphere\n"
+              << "  --continuous           sweep spheres through each step to the exact time of impact\n"
+              << "                         (not with --balls)\n"
+              << "  --event-driven         fly spheres on exact parabolas from contact to contact,\n"
+              << "                         skipping the frames in between (not with --balls)\n"
+              << "  --integrator <i>       motion between bounces: euler, verlet or rk4 (default euler)\n"
+              << "  --balls                simulate all launches at once as spheres in one ball set\n"
+              << "  --collide              with --balls, bounce the balls off each other too, launching them\n"
+              << "                         from a cube of points instead of a single one\n"
+              << "  --launches <n>         number of launches, evenly spread around +Z (default 72)\n"
+              << "  --speed <v>            launch speed (default 5)\n"
+              << "  --height <z>           launch height (default 10)\n"
+              << "  --dt <seconds>         simulation time step (default 0.0166667)\n"
+              << "  --duration <seconds>   maximum simulated time per launch (default 30)\n"
+              << "  --output <file.csv>    write results to a file instead of stdout\n"
+              << "  --threads <n>          worker threads (default: all cores)\n"
+              << "Sweep mode:\n"
+              << "  --sweep-angles <min:max:n>   launch angles in degrees (default 0:355:72)\n"
+              << "  --sweep-speeds <min:max:n>   launch speeds (default 5:5:1)\n"
+              << "  --sweep-heights <min:max:n>  launch heights (default 10:10:1)\n"
+              << "  --raster <file>              write the landing/final position grid as a binary raster\n";
+}
+
+static bool parseLayout(const char* value, HeightGridLayout& layout) {
+    if (std::strcmp(value, "rowmajor") == 0) {
+        layout = HeightGridLayout::RowMajor;
+    } else if (std::strcmp(value, "tiled") == 0) {
+        layout = HeightGridLayout::Tiled;
+    } else if (std::strcmp(value, "morton") == 0) {
+        layout = HeightGridLayout::Morton;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseIntegrator(const char* value, Integrator& integrator) {
+    for (const Integrator candidate : {Integrator::SemiImplicitEuler, Integrator::VelocityVerlet,
+                                       Integrator::RungeKutta4}) {
+        if (std::strcmp(value, integratorName(candidate)) == 0) {
+            integrator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// parse "min:max:count"
+static bool parseAxis(const char* value, SweepAxis& axis) {
+    char* end = nullptr;
+    axis.minimum = std::strtof(value, &end);
+    if (*end != ':') {
+        return false;
+    }
+    axis.maximum = std::strtof(end + 1, &end);
+    if (*end != ':') {
+        return false;
+    }
+    axis.count = std::strtoul(end + 1, &end, 10);
+    return *end == '\0' && axis.count > 0;
+}
+
+static bool parseOptions(const int argc, char** argv, BatchOptions& options) {
+    for (int arg = 1; arg < argc; arg++) {
+        const char* option = argv[arg];
+        if (std::strcmp(option, "--polyhedron") == 0) {
+            options.useSphere = false;
+            continue;
+        }
+        if (std::strcmp(option, "--continuous") == 0) {
+            options.continuousCollision = true;
+            continue;
+        }
+        if (std::strcmp(option, "--event-driven") == 0) {
+            options.eventDriven = true;
+            continue;
+        }
+        if (std::strcmp(option, "--heightfield") == 0) {
+            options.heightfieldOnly = true;
+            continue;
+        }
+        if (std::strcmp(option, "--quantize") == 0) {
+            options.quantizeHeights = true;
+            continue;
+        }
+        if (std::strcmp(option, "--balls") == 0) {
+            options.useBallSet = true;
+            continue;
+        }
+        if (std::strcmp(option, "--collide") == 0) {
+            options.collideBalls = true;
+            continue;
+        }
+        if (std::strcmp(option, "--help") == 0 || arg + 1 >= argc) {
+            return false;
+        }
+
+        const char* value = argv[++arg];
+        if (std::strcmp(option, "--terrain") == 0) {
+            options.terrainFileName = value;
+        } else if (std::strcmp(option, "--memory") == 0) {
+            options.memoryBudget = std::strtoul(value, nullptr, 10);
+        } else if (std::strcmp(option, "--scale") == 0) {
+            options.xyScale = std::strtof(value, nullptr);
+        } else if (std::strcmp(option, "--layout") == 0) {
+            if (!parseLayout(value, options.heightLayout)) {
+                return false;
+            }
+        } else if (std::strcmp(option, "--integrator") == 0) {
+            if (!parseIntegrator(value, options.integrator)) {
+                return false;
+            }
+        } else if (std::strcmp(option, "--ball") == 0) {
+            options.ballFileName = value;
+        } else if (std::strcmp(option, "--launches") == 0) {
+            options.launches = std::strtol(value, nullptr, 10);
+        } else if (std::strcmp(option, "--speed") == 0) {
+            options.launchSpeed = std::strtof(value, nullptr);
+        } else if (std::strcmp(option, "--height") == 0) {
+            options.launchHeight = std::strtof(value, nullptr);
+        } else if (std::strcmp(option, "--dt") == 0) {
+            options.frameTime = std::strtof(value, nullptr);
+        } else if (std::strcmp(option, "--duration") == 0) {
+            options.duration = std::strtof(value, nullptr);
+        } else if (std::strcmp(option, "--output") == 0) {
+            options.outputFileName = value;
+        } else if (std::strcmp(option, "--threads") == 0) {
+            options.threads = std::strtoul(value, nullptr, 10);
+        } else if (std::strcmp(option, "--sweep-angles") == 0) {
+            options.isSweep = true;
+            if (!parseAxis(value, options.sweepAngles)) {
+                return false;
+            }
+        } else if (std::strcmp(option, "--sweep-speeds") == 0) {
+            options.isSweep = true;
+            if (!parseAxis(value, options.sweepSpeeds)) {
+                return false;
+            }
+        } else if (std::strcmp(option, "--sweep-heights") == 0) {
+            options.isSweep = true;
+            if (!parseAxis(value, options.sweepHeights)) {
+                return false;
+            }
+        } else if (std::strcmp(option, "--raster") == 0) {
+            options.isSweep = true;
+            options.rasterFileName = value;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+
+    return options.launches > 0 && options.frameTime > 0.0f && options.xyScale > 0.0f;
+}
+
+static float launchAngleOf(const BatchOptions& options, const long launch) {
+    return 360.0f * launch / options.launches;
+}
+
+// simulate each launch on its own, one worker-private Simulation per thread
+static std::vector<LaunchResult> runLaunches(const BatchOptions& options, const HeightField& terrain,
+                                             const IndexedFaceSurface& ball, WorkStealingExecutor& executor) {
+    std::vector<Simulation> simulations(executor.threadCount());
+    for (auto& simulation : simulations) {
+        simulation.terrain = &terrain;
+        simulation.ballModel = &ball;
+        simulation.useSphere = options.useSphere;
+        simulation.continuousCollision = options.continuousCollision;
+        simulation.eventDriven = options.eventDriven;
+        simulation.integrator = options.integrator;
+        simulation.frameTime = options.frameTime;
+        simulation.launchPosition = Cartesian3(0.0f, 0.0f, options.launchHeight);
+        simulation.launchVelocity = Cartesian3(options.launchSpeed, 0.0f, 0.0f);
+    }
+
+    const unsigned long maxFrames = static_cast<unsigned long>(options.duration / options.frameTime);
+    return executor.map<LaunchResult>(options.launches, [&](const size_t launch, const unsigned worker) {
+        Simulation& simulation = simulations[worker];
+        simulation.launchAngle = launchAngleOf(options, launch);
+        simulation.reset();
+
+        const SimulationOutcome outcome = simulation.run(maxFrames, restSpeedThreshold);
+        return LaunchResult{
+            simulation.launchAngle,
+            simulation.landingPosition,
+            simulation.landingTime,
+            simulation.bounceCount,
+            simulation.ballPosition,
+            simulation.ballVelocity,
+            simulation.elapsedTime,
+            simulation.frameNumber,
+            outcome
+        };
+    });
+}
+
+// Where a ball set launch starts: all from the same point, or when the balls collide with each other
+// from a lattice of points two diameters apart, a cube above the launch point, so they do not start inside each other
+static Cartesian3 launchPositionOf(const BatchOptions& options, const long index) {
+    Cartesian3 position(0.0f, 0.0f, options.launchHeight);
+    if (!options.collideBalls) {
+        return position;
+    }
+    long side = 1;
+    while (side * side * side < options.launches) {
+        side++;
+    }
+    const float spacing = 4.0f * sphereRadius;
+    position.x += (index % side - 0.5f * (side - 1)) * spacing;
+    position.y += (index / side % side - 0.5f * (side - 1)) * spacing;
+    position.z += index / (side * side) * spacing;
+    return position;
+}
+
+// step launches together in ball sets of ballSetChunkSize, for the whole duration;
+// balls that collide with each other all have to be in the same set
+static std::vector<LaunchResult> runBallSets(const BatchOptions& options, const HeightField& terrain,
+                                             WorkStealingExecutor& executor) {
+    std::vector<LaunchResult> results(options.launches);
+    const unsigned long maxFrames = static_cast<unsigned long>(options.duration / options.frameTime);
+    const long chunkSize = options.collideBalls ? std::max(options.launches, 1L) : ballSetChunkSize;
+    const long chunks = (options.launches + chunkSize - 1) / chunkSize;
+
+    executor.parallelFor(chunks, [&](const size_t chunk, unsigned) {
+        const long firstLaunch = chunk * chunkSize;
+        const long lastLaunch = std::min(options.launches, firstLaunch + chunkSize);
+
+        BallSet balls;
+        balls.collideBalls = options.collideBalls;
+        balls.reserve(lastLaunch - firstLaunch);
+        for (long launch = firstLaunch; launch < lastLaunch; launch++) {
+            balls.addBall(launchPositionOf(options, launch - firstLaunch),
+                          Matrix4::rotationZ(launchAngleOf(options, launch)) *
+                          Cartesian3(options.launchSpeed, 0.0f, 0.0f),
+                          sphereRadius);
+        }
+
+        // the integrator is chosen once per ball set, outside the frame loop
+        const auto runFrames = [&](auto scheme) {
+            for (unsigned long frame = 0; frame < maxFrames; frame++) {
+                balls.update<decltype(scheme)>(terrain, options.frameTime);
+            }
+        };
+        switch (options.integrator) {
+            case Integrator::VelocityVerlet:
+                runFrames(VelocityVerlet());
+                break;
+            case Integrator::RungeKutta4:
+                runFrames(RungeKutta4());
+                break;
+            default:
+                runFrames(SemiImplicitEuler());
+                break;
+        }
+
+        for (long launch = firstLaunch; launch < lastLaunch; launch++) {
+            LaunchResult& result = results[launch];
+            result.launchAngle = launchAngleOf(options, launch);
+            result.finalPosition = balls.position(launch - firstLaunch);
+            result.finalVelocity = balls.velocity(launch - firstLaunch);
+            result.elapsedTime = maxFrames * options.frameTime;
+            result.frames = maxFrames;
+        }
+    });
+
+    return results;
+}
+
+// run the launch grid, write the raster if asked and the CSV summary to out
+static int runSweep(const BatchOptions& options, const HeightField& terrain, const IndexedFaceSurface& ball,
+                    WorkStealingExecutor& executor, std::ostream& out) {
+    LaunchSweep sweep;
+    sweep.angles = options.sweepAngles;
+    sweep.speeds = options.sweepSpeeds;
+    sweep.heights = options.sweepHeights;
+    sweep.terrain = &terrain;
+    sweep.ballModel = &ball;
+    sweep.useSphere = options.useSphere;
+    sweep.continuousCollision = options.continuousCollision;
+    sweep.eventDriven = options.eventDriven;
+    sweep.integrator = options.integrator;
+    sweep.frameTime = options.frameTime;
+    sweep.duration = options.duration;
+    sweep.restSpeedThreshold = restSpeedThreshold;
+
+    const auto startTime = std::chrono::steady_clock::now();
+    sweep.run(executor);
+    const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - startTime;
+
+    if (!options.rasterFileName.empty() && !sweep.writeRaster(options.rasterFileName.data())) {
+        std::cerr << "Unable to write " << options.rasterFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+    sweep.writeSummary(out);
+
+    std::cerr << sweep.launchCount() << " sweep launches on " << executor.threadCount() << " threads in "
+              << wallTime.count() << " s" << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // the paged terrain has no triangles and no in-memory heights to lay out or quantize
+    const bool isPaged = hasFileExtension(options.terrainFileName.data(), ".demt");
+    if (isPaged && (!options.useSphere || options.continuousCollision || options.eventDriven ||
+                    options.heightLayout != HeightGridLayout::RowMajor || options.heightfieldOnly ||
+                    options.quantizeHeights)) {
+        std::cerr << "A .demt terrain does not support --polyhedron, --continuous, --event-driven, --layout, "
+                  << "--heightfield or --quantize" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Terrain terrain;
+    PagedTerrain pagedTerrain;
+    const HeightField* heightField = &terrain;
+    if (isPaged) {
+        if (!pagedTerrain.open(options.terrainFileName.data(), options.xyScale,
+                               options.memoryBudget * bytesPerMegabyte)) {
+            std::cerr << "Unable to read terrain " << options.terrainFileName << std::endl;
+            return EXIT_FAILURE;
+        }
+        heightField = &pagedTerrain;
+    } else {
+        terrain.setHeightLayout(options.heightLayout);
+        terrain.setHeightfieldOnly(options.heightfieldOnly);
+        if (options.quantizeHeights) {
+            terrain.setHeightEncoding(HeightGridEncoding::Quantized16);
+        }
+        if (!terrain.readTerrainFile(options.terrainFileName.data(), options.xyScale)) {
+            std::cerr << "Unable to read terrain " << options.terrainFileName << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.quantizeHeights) {
+        const HeightQuantizationError& error = terrain.heightValues.quantizationError();
+        const size_t floatBytes = terrain.heightValues.rows() * terrain.heightValues.columns() * sizeof(float);
+        std::cerr << "Quantized heights: " << terrain.heightValues.storageBytes() << " bytes instead of "
+                  << floatBytes << ", error max " << error.maximum << " rms " << error.rms
+                  << ", largest step " << error.maximumStep << std::endl;
+    }
+    IndexedFaceSurface ball;
+    if (!ball.readIndexedFaceFile(options.ballFileName.data())) {
+        std::cerr << "Unable to read ball " << options.ballFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream outFile;
+    if (!options.outputFileName.empty()) {
+        outFile.open(options.outputFileName);
+        if (!outFile) {
+            std::cerr << "Unable to write " << options.outputFileName << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& out = options.outputFileName.empty() ? std::cout : outFile;
+
+    WorkStealingExecutor executor(options.threads);
+    if (options.isSweep) {
+        return runSweep(options, *heightField, ball, executor, out);
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+    const std::vector<LaunchResult> results = options.useBallSet
+                                                  ? runBallSets(options, *heightField, executor)
+                                                  : runLaunches(options, *heightField, ball, executor);
+    const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - startTime;
+
+    unsigned long totalFrames = 0;
+    if (options.useBallSet) {
+        out << "launch,angle,finalX,finalY,finalZ,finalVX,finalVY,finalVZ\n";
+    } else {
+        out << "launch,angle,landingX,landingY,landingZ,landingTime,bounces,finalX,finalY,finalZ,time,outcome\n";
+    }
+    for (long launch = 0; launch < options.launches; launch++) {
+        const LaunchResult& result = results[launch];
+        totalFrames += result.frames;
+
+        out << launch << ',' << result.launchAngle << ',';
+        if (options.useBallSet) {
+            out << result.finalPosition.x << ',' << result.finalPosition.y << ',' << result.finalPosition.z << ','
+                << result.finalVelocity.x << ',' << result.finalVelocity.y << ',' << result.finalVelocity.z << '\n';
+        } else {
+            out << result.landingPosition.x << ',' << result.landingPosition.y << ','
+                << result.landingPosition.z << ',' << result.landingTime << ','
+                << result.bounceCount << ','
+                << result.finalPosition.x << ',' << result.finalPosition.y << ','
+                << result.finalPosition.z << ',' << result.elapsedTime << ','
+                << simulationOutcomeName(result.outcome) << '\n';
+        }
+    }
+
+    std::cerr << options.launches << " launches, " << totalFrames << " ball frames on "
+              << executor.threadCount() << " threads in " << wallTime.count() << " s ("
+              << totalFrames / wallTime.count() << " ball frames/s)" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,11 @@
+# Converter from text .dem terrains to binary .demb
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+TARGET = ../../bin/dem2demb
+OBJECTS_DIR=../../build/dem2demb/obj
+
+include(../../common.pri)
+include(../../core/core.pri)
+
+SOURCES += main.cpp
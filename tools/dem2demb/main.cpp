@@ -0,0 +1,146 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include "PagedTerrain.h"
+#include "Terrain.h"
+
+// Converts a text .dem terrain into the binary, memory-mappable .demb format,
+// or a .dem or .demb into the tiled .demt format that PagedTerrain streams from.
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <input.dem> <output.demb> [options]\n"
+              << "       " << program << " <input.dem|input.demb> <output.demt> --tiles <n>\n"
+              << "  --scale <s>     x-y scale the stored normals are computed with (default 3)\n"
+              << "  --no-normals    only store the heights, normals are recomputed on load\n"
+              << "  --tiles <n>     write a .demt of n x n square tiles instead\n";
+}
+
+// Cut the heights into tiles. A .demb is streamed from its mapping, so it never has to fit in memory
+static int writeTiles(const char* inputFileName, const char* outputFileName, const long tileSize) {
+    const auto start = std::chrono::steady_clock::now();
+    bool written = false;
+    long rows = 0, columns = 0;
+    if (hasFileExtension(inputFileName, ".demb")) {
+        MappedFile file;
+        TerrainFileHeader header{};
+        if (!file.open(inputFileName) || file.size() < sizeof(header)) {
+            std::cerr << "Unable to read terrain " << inputFileName << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        rows = header.rows;
+        columns = header.columns;
+        if (std::memcmp(header.magic, "DEMB", 4) != 0 ||
+            header.heightsOffset + static_cast<std::uint64_t>(rows) * columns * sizeof(float) > file.size()) {
+            std::cerr << inputFileName << " is not a valid .demb" << std::endl;
+            return EXIT_FAILURE;
+        }
+        const float* heights = reinterpret_cast<const float*>(file.data() + header.heightsOffset);
+        written = writeTiledTerrainFile(outputFileName, rows, columns, tileSize,
+                                        [&](long row, long column, long count, float* values) {
+                                            std::memcpy(values, heights + static_cast<size_t>(row) * columns + column,
+                                                        count * sizeof(float));
+                                        });
+    } else {
+        Terrain terrain;
+        terrain.setHeightfieldOnly(true);
+        if (!terrain.readTerrainFile(inputFileName, 1.0f)) {
+            std::cerr << "Unable to read terrain " << inputFileName << std::endl;
+            return EXIT_FAILURE;
+        }
+        const HeightGrid& heightValues = terrain.heightValues;
+        rows = heightValues.rows();
+        columns = heightValues.columns();
+        written = writeTiledTerrainFile(outputFileName, rows, columns, tileSize,
+                                        [&](long row, long column, long count, float* values) {
+                                            for (long index = 0; index < count; index++) {
+                                                values[index] = heightValues(row, column + index);
+                                            }
+                                        });
+    }
+    if (!written) {
+        std::cerr << "Unable to write " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::chrono::duration<double, std::milli> writeTime = std::chrono::steady_clock::now() - start;
+
+    // open it back to check the file
+    PagedTerrain pagedTerrain;
+    if (!pagedTerrain.open(outputFileName, 1.0f, 0)) {
+        std::cerr << "Unable to read back " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << inputFileName << ": " << rows << " x " << columns << " heights in " << tileSize << " x " << tileSize
+              << " tiles, written in " << writeTime.count() << " ms" << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* inputFileName = argv[1];
+    const char* outputFileName = argv[2];
+    float xyScale = 3.0f;
+    bool includeNormals = true;
+    long tileSize = 0;
+    for (int arg = 3; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--no-normals") == 0) {
+            includeNormals = false;
+        } else if (std::strcmp(argv[arg], "--scale") == 0 && arg + 1 < argc) {
+            xyScale = std::strtof(argv[++arg], nullptr);
+        } else if (std::strcmp(argv[arg], "--tiles") == 0 && arg + 1 < argc) {
+            tileSize = std::strtol(argv[++arg], nullptr, 10);
+            if (tileSize < 1) {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (tileSize > 0) {
+        return writeTiles(inputFileName, outputFileName, tileSize);
+    }
+
+    // the normals are written straight from the heights, so the text terrain needs no mesh
+    Terrain terrain;
+    terrain.setHeightfieldOnly(true);
+    const auto textStart = std::chrono::steady_clock::now();
+    if (!terrain.readTerrainFile(inputFileName, xyScale)) {
+        std::cerr << "Unable to read terrain " << inputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::chrono::duration<double, std::milli> textTime = std::chrono::steady_clock::now() - textStart;
+
+    if (!terrain.writeBinaryTerrainFile(outputFileName, includeNormals)) {
+        std::cerr << "Unable to write " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // load it back, both to check the file and to show the difference
+    Terrain binaryTerrain;
+    const auto binaryStart = std::chrono::steady_clock::now();
+    if (!binaryTerrain.readBinaryTerrainFile(outputFileName, xyScale)) {
+        std::cerr << "Unable to read back " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::chrono::duration<double, std::milli> binaryTime = std::chrono::steady_clock::now() - binaryStart;
+
+    std::cerr << inputFileName << ": " << terrain.heightValues.rows() << " x " << terrain.heightValues.columns()
+              << " heights, text load " << textTime.count() << " ms, binary load " << binaryTime.count()
+              << " ms" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,11 @@
+# Converter from text .face surfaces to binary .faceb
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+TARGET = ../../bin/face2faceb
+OBJECTS_DIR=../../build/face2faceb/obj
+
+include(../../common.pri)
+include(../../core/core.pri)
+
+SOURCES += main.cpp
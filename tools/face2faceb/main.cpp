@@ -0,0 +1,46 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "IndexedFaceSurface.h"
+
+// Converts a text .face surface into the binary, memory-mappable .faceb format,
+// with normals, bounding sphere and inertial tensor precomputed.
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.face> <output.faceb>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const char* inputFileName = argv[1];
+    const char* outputFileName = argv[2];
+
+    IndexedFaceSurface surface;
+    const auto textStart = std::chrono::steady_clock::now();
+    if (!surface.readIndexedFaceFile(inputFileName)) {
+        std::cerr << "Unable to read surface " << inputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::chrono::duration<double, std::milli> textTime = std::chrono::steady_clock::now() - textStart;
+
+    if (!surface.writeBinaryIndexedFaceFile(outputFileName)) {
+        std::cerr << "Unable to write " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // load it back, both to check the file and to show the difference
+    IndexedFaceSurface binarySurface;
+    const auto binaryStart = std::chrono::steady_clock::now();
+    if (!binarySurface.readBinaryIndexedFaceFile(outputFileName)) {
+        std::cerr << "Unable to read back " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::chrono::duration<double, std::milli> binaryTime = std::chrono::steady_clock::now() - binaryStart;
+
+    std::cerr << inputFileName << ": " << surface.vertices.size() << " vertices, " << surface.normals.size()
+              << " faces, bounding radius " << surface.boundingSphereRadius << ", text load " << textTime.count()
+              << " ms, binary load " << binaryTime.count() << " ms" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,11 @@
+# Benchmark of the text .dem loader against the stream based one it replaced
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+TARGET = ../../bin/loadbench
+OBJECTS_DIR=../../build/loadbench/obj
+
+include(../../common.pri)
+include(../../core/core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Terrain.h"
+
+// Times Terrain::readHeightValues against the ifstream >> loop it replaced, on an existing
+// .dem or on a generated one. Only the heights are read; building the mesh is the same for both.
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [input.dem] [options]\n"
+              << "  --size <n>      rows and columns of the generated terrain (default 10000)\n"
+              << "  --keep <file>   where to write the generated terrain, kept afterwards\n"
+              << "  --repeat <n>    loads of each kind, the fastest is reported (default 1)\n";
+}
+
+// the previous loader, kept here as the reference
+static bool readHeightValuesWithStream(const char* fileName, std::vector<std::vector<float>>& heightValues) {
+    std::ifstream inFile(fileName);
+    if (!inFile) {
+        return false;
+    }
+
+    long height = 0, width = 0;
+    inFile >> height >> width;
+
+    heightValues.resize(height);
+    for (int row = 0; row < height; row++) {
+        heightValues[row].resize(width);
+
+        for (int col = 0; col < width; col++) {
+            inFile >> heightValues[row][col];
+        }
+    }
+
+    return static_cast<bool>(inFile);
+}
+
+// rolling heights with a little noise, written the way the assets are
+static bool writeTerrain(const char* fileName, const long size) {
+    FILE* outFile = std::fopen(fileName, "w");
+    if (outFile == nullptr) {
+        return false;
+    }
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    std::fprintf(outFile, "%ld %ld\n", size, size);
+    for (long row = 0; row < size; row++) {
+        for (long col = 0; col < size; col++) {
+            const float height = 3.0f * std::sin(0.01f * row) * std::cos(0.013f * col) + noise(generator);
+            std::fprintf(outFile, col + 1 < size ? "%.4f " : "%.4f\n", height);
+        }
+    }
+
+    return std::fclose(outFile) == 0;
+}
+
+template <typename Load>
+static double fastestMilliseconds(const int repeat, const Load& load) {
+    double fastest = 0.0;
+    for (int run = 0; run < repeat; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!load()) {
+            return -1.0;
+        }
+        const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        if (run == 0 || time.count() < fastest) {
+            fastest = time.count();
+        }
+    }
+    return fastest;
+}
+
+int main(int argc, char** argv) {
+    std::string inputFileName;
+    std::string keepFileName;
+    long size = 10000;
+    int repeat = 1;
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--size") == 0 && arg + 1 < argc) {
+            size = std::strtol(argv[++arg], nullptr, 10);
+        } else if (std::strcmp(argv[arg], "--keep") == 0 && arg + 1 < argc) {
+            keepFileName = argv[++arg];
+        } else if (std::strcmp(argv[arg], "--repeat") == 0 && arg + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++arg]));
+        } else if (argv[arg][0] != '-' && inputFileName.empty()) {
+            inputFileName = argv[arg];
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const bool isGenerated = inputFileName.empty();
+    if (isGenerated) {
+        if (size < 2) {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        inputFileName = keepFileName.empty() ? "loadbench-" + std::to_string(size) + ".dem" : keepFileName;
+        std::cerr << "Writing " << size << " x " << size << " terrain to " << inputFileName << std::endl;
+        if (!writeTerrain(inputFileName.c_str(), size)) {
+            std::cerr << "Unable to write " << inputFileName << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::vector<float>> streamHeights;
+    const double streamTime = fastestMilliseconds(repeat, [&]() {
+        return readHeightValuesWithStream(inputFileName.c_str(), streamHeights);
+    });
+
+    Terrain terrain;
+    const double parserTime = fastestMilliseconds(repeat, [&]() {
+        return terrain.readHeightValues(inputFileName.c_str());
+    });
+
+    if (isGenerated && keepFileName.empty()) {
+        std::remove(inputFileName.c_str());
+    }
+    if (streamTime < 0.0 || parserTime < 0.0) {
+        std::cerr << "Unable to read terrain " << inputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // both loaders must agree on every height
+    const HeightGrid& heights = terrain.heightValues;
+    bool isSame = static_cast<long>(streamHeights.size()) == heights.rows();
+    for (long row = 0; row < heights.rows() && isSame; row++) {
+        isSame = static_cast<long>(streamHeights[row].size()) == heights.columns();
+        for (long col = 0; col < heights.columns() && isSame; col++) {
+            isSame = streamHeights[row][col] == heights(row, col);
+        }
+    }
+    if (!isSame) {
+        std::cerr << "Loaders disagree on " << inputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const size_t nValues = heights.rows() * heights.columns();
+    std::cout << inputFileName << ": " << heights.rows() << " x " << heights.columns()
+              << " heights, ifstream " << streamTime << " ms, from_chars " << parserTime << " ms ("
+              << streamTime / parserTime << "x, " << nValues / parserTime / 1000.0 << " M heights/s)" << std::endl;
+
+    return EXIT_SUCCESS;
+}